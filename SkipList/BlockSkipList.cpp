@@ -0,0 +1,151 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <vector>
+#include "BlockSkipList.h"
+#include "SkipList3.h"
+
+// 消耗操作结果，避免查找被编译器优化掉
+static unsigned long s_sink = 0;
+
+// xorshift64，生成测试用的键
+static uint64_t nextRandom(uint64_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// 与std::set对照的随机操作测试
+static bool verify()
+{
+    BlockSkipList<int64_t> skipList;
+    std::set<int64_t> expected;
+
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    for (int i = 0; i < 200000; ++i)
+    {
+        auto random = nextRandom(state);
+        int64_t key = (int64_t)(random % 10000) - 5000;
+        bool ok = true;
+        switch (random / 10000 % 4)
+        {
+        case 0:
+        case 1:
+            ok = skipList.insert(key) == expected.insert(key).second;
+            break;
+        case 2:
+            ok = skipList.remove(key) == (expected.erase(key) > 0);
+            break;
+        default:
+            ok = (skipList.find(key) != nullptr) == (expected.count(key) > 0);
+            break;
+        }
+        if (!ok)
+        {
+            printf("mismatch at %d, key %lld\n", i, (long long)key);
+            return false;
+        }
+    }
+
+    long rank = 0;
+    auto it = expected.begin();
+    for (auto data : skipList)
+    {
+        if (it == expected.end() || *it != data || skipList.getRank(data) != rank)
+        {
+            printf("order mismatch at rank %ld\n", rank);
+            return false;
+        }
+        ++it;
+        ++rank;
+    }
+
+    return it == expected.end();
+}
+
+template <typename F>
+static double measure(long count, F &&func)
+{
+    auto begin = std::chrono::steady_clock::now();
+    func();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - begin;
+    return elapsed.count() / count;
+}
+
+// 随机插入、随机查找、按排名查找、顺序遍历、随机删除各count次，输出每次操作的纳秒数
+template <typename SkipListType>
+static void benchmark(const char *name, long count)
+{
+    std::vector<int64_t> keyArray(count);
+    uint64_t state = 0x2545f4914f6cdd1dull;
+    for (auto &key : keyArray)
+    {
+        key = (int64_t)(nextRandom(state) >> 1);
+    }
+
+    auto skipList = new SkipListType;
+
+    auto insertTime = measure(count, [&]()
+                              {
+        for (auto key : keyArray)
+        {
+            s_sink += skipList->insert(key);
+        } });
+
+    auto findTime = measure(count, [&]()
+                            {
+        for (long i = count - 1; i >= 0; --i)
+        {
+            s_sink += skipList->find(keyArray[(i * 7919) % count]) != nullptr;
+        } });
+
+    auto rankTime = measure(count, [&]()
+                            {
+        long length = skipList->size();
+        for (long i = 0; i < count; ++i)
+        {
+            s_sink += *skipList->getByRank((i * 7919) % length) & 1;
+        } });
+
+    auto scanTime = measure(count, [&]()
+                            {
+        for (auto data : *skipList)
+        {
+            s_sink += data & 1;
+        } });
+
+    auto removeTime = measure(count, [&]()
+                              {
+        for (auto key : keyArray)
+        {
+            s_sink += skipList->remove(key);
+        } });
+
+    delete skipList;
+
+    printf("%-20s %10.0f %10.0f %10.0f %10.1f %10.0f\n", name, insertTime, findTime, rankTime, scanTime, removeTime);
+}
+
+int main(int argc, char *argv[])
+{
+    printf("begin\n");
+
+    bool ok = verify();
+    printf("verify: %s\n", ok ? "ok" : "FAILED");
+
+    long count = argc > 1 ? atol(argv[1]) : 1000000;
+    printf("%ld keys, ns/op\n", count);
+    printf("%-20s %10s %10s %10s %10s %10s\n", "", "insert", "find", "rank", "scan", "remove");
+    benchmark<SkipList<int64_t>>("SkipList3", count);
+    benchmark<BlockSkipList<int64_t, std::less<int64_t>, SkipListNewAllocator, SkipListLevelGen<>, 16>>("BlockSkipList<16>", count);
+    benchmark<BlockSkipList<int64_t, std::less<int64_t>, SkipListNewAllocator, SkipListLevelGen<>, 32>>("BlockSkipList<32>", count);
+    benchmark<BlockSkipList<int64_t, std::less<int64_t>, SkipListNewAllocator, SkipListLevelGen<>, 64>>("BlockSkipList<64>", count);
+
+    printf("end\n");
+
+    return ok ? 0 : 1;
+}
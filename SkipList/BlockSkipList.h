@@ -0,0 +1,1029 @@
+#ifndef _BLOCK_SKIPLIST_H_
+#define _BLOCK_SKIPLIST_H_
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "SkipListAllocator.h"
+#include "SkipListLevelGen.h"
+#include "SkipListTraits.h"
+
+#if defined(__AVX2__) || defined(__SSE4_2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define BLOCK_SKIPLIST_SIMD
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// 块内查找：返回有序数组keys[0, count)中小于key的个数，按编译选项选用AVX2/SSE指令，
+// 数据有序，因此比较结果是连续的低位，遇到不全小于key的一组即可结束。
+// Key为32/64位有符号整数，按原类型访问keys：long long与int64_t可能是不同的类型，
+// 不能把数据块转换成int64_t指针读取；向量加载使用的__m128i/__m256i允许与任意类型别名
+class BlockSkipListSimd
+{
+public:
+    template <typename Key>
+    static unsigned int countLess(const Key *keys, unsigned int count, Key key)
+    {
+        static_assert(std::is_integral<Key>::value && std::is_signed<Key>::value, "Key must be a signed integer");
+        if constexpr (sizeof(Key) == sizeof(int64_t))
+        {
+            return countLess64(keys, count, key);
+        }
+        else
+        {
+            static_assert(sizeof(Key) == sizeof(int32_t), "Key must be 32 or 64 bits");
+            return countLess32(keys, count, key);
+        }
+    }
+
+private:
+    template <typename Key>
+    static unsigned int countLess64(const Key *keys, unsigned int count, Key key);
+    template <typename Key>
+    static unsigned int countLess32(const Key *keys, unsigned int count, Key key);
+
+    static unsigned int popCount(unsigned int x)
+    {
+#ifdef _MSC_VER
+        return __popcnt(x);
+#else
+        return __builtin_popcount(x);
+#endif
+    }
+};
+
+template <typename Key>
+inline unsigned int BlockSkipListSimd::countLess64(const Key *keys, unsigned int count, Key key)
+{
+    unsigned int i = 0;
+#if defined(__AVX2__)
+    auto keyVec = _mm256_set1_epi64x((int64_t)key);
+    for (; i + 4 <= count; i += 4)
+    {
+        auto dataVec = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+        auto mask = (unsigned int)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(keyVec, dataVec)));
+        if (mask != 0xf)
+        {
+            return i + popCount(mask);
+        }
+    }
+#elif defined(__SSE4_2__)
+    auto keyVec = _mm_set1_epi64x((int64_t)key);
+    for (; i + 2 <= count; i += 2)
+    {
+        auto dataVec = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+        auto mask = (unsigned int)_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(keyVec, dataVec)));
+        if (mask != 0x3)
+        {
+            return i + popCount(mask);
+        }
+    }
+#endif
+    while (i < count && keys[i] < key)
+    {
+        ++i;
+    }
+    return i;
+}
+
+template <typename Key>
+inline unsigned int BlockSkipListSimd::countLess32(const Key *keys, unsigned int count, Key key)
+{
+    unsigned int i = 0;
+#if defined(__AVX2__)
+    auto keyVec = _mm256_set1_epi32((int32_t)key);
+    for (; i + 8 <= count; i += 8)
+    {
+        auto dataVec = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+        auto mask = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(keyVec, dataVec)));
+        if (mask != 0xff)
+        {
+            return i + popCount(mask);
+        }
+    }
+#elif defined(BLOCK_SKIPLIST_SIMD)
+    auto keyVec = _mm_set1_epi32((int32_t)key);
+    for (; i + 4 <= count; i += 4)
+    {
+        auto dataVec = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+        auto mask = (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(keyVec, dataVec)));
+        if (mask != 0xf)
+        {
+            return i + popCount(mask);
+        }
+    }
+#endif
+    while (i < count && keys[i] < key)
+    {
+        ++i;
+    }
+    return i;
+}
+
+// 胖节点跳表：
+// 每个节点保存一个有序的数据块，最多BlockSize个，建议16~64个；各层只按块的第一个数据索引，
+// 查找时先在各层之间跳转找到数据所在的块，再在块内查找，指针跳转的次数约为SkipList3的1/BlockSize。
+// 有符号的32/64位整数用std::less比较时，块内查找使用SIMD指令。
+// 头节点也是一个数据块，保存最小的若干数据，可以为空；其余节点都不为空。
+// 块满时分裂，删除后块过小时与后继合并。跨度按数据个数计算：
+// 第i层从节点X到后继的跨度是X(含)到后继(不含)之间所有块的数据个数之和。
+// 接口与SkipList3相同，但插入/删除会在块内移动数据，之前返回的数据指针和迭代器都会失效。
+template <typename T, class CmpLess = std::less<T>, class Allocator = SkipListNewAllocator, class LevelGen = SkipListLevelGen<>, unsigned int BlockSize = 32>
+class BlockSkipList
+{
+    static_assert(BlockSize >= 4 && BlockSize <= UCHAR_MAX, "BlockSize must be in [4, 255]");
+
+protected:
+    struct BlockNode;
+
+    struct SkipLevel
+    {
+        BlockNode *m_next = nullptr;
+        unsigned long m_span = 0;
+    };
+
+    struct BlockNode
+    {
+        BlockNode *m_prev = nullptr;
+        // 节点层高
+        unsigned char m_level = 0;
+        // 块内数据个数
+        unsigned char m_count = 0;
+        // 有序数据块，只有前m_count个有效
+        T m_dataArray[BlockSize];
+        // 层数组，与节点一次分配，实际长度为节点层高
+        SkipLevel m_levelArray[1];
+    };
+
+public:
+    // 双向只读迭代器，指向块及块内位置
+    class ConstIterator
+    {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        ConstIterator() = default;
+
+        reference operator*() const { return m_node->m_dataArray[m_index]; }
+        pointer operator->() const { return &m_node->m_dataArray[m_index]; }
+
+        ConstIterator &operator++();
+        ConstIterator operator++(int)
+        {
+            auto it = *this;
+            ++*this;
+            return it;
+        }
+        // end()后退得到最后一个数据
+        ConstIterator &operator--();
+        ConstIterator operator--(int)
+        {
+            auto it = *this;
+            --*this;
+            return it;
+        }
+
+        bool operator==(const ConstIterator &other) const { return m_node == other.m_node && m_index == other.m_index; }
+        bool operator!=(const ConstIterator &other) const { return !(*this == other); }
+
+    private:
+        friend class BlockSkipList;
+
+        // 位于块末尾时移动到后继块的开头
+        ConstIterator(const BlockNode *node, unsigned int index, const BlockSkipList *skipList);
+
+        // 当前块，nullptr表示end()
+        const BlockNode *m_node = nullptr;
+        unsigned int m_index = 0;
+        const BlockSkipList *m_skipList = nullptr;
+    };
+
+    using value_type = T;
+    using size_type = size_t;
+    using iterator = ConstIterator;
+    using const_iterator = ConstIterator;
+    using reverse_iterator = std::reverse_iterator<ConstIterator>;
+    using const_reverse_iterator = std::reverse_iterator<ConstIterator>;
+
+    explicit BlockSkipList(const LevelGen &levelGen = LevelGen());
+    ~BlockSkipList();
+
+    BlockSkipList(const BlockSkipList &) = delete;
+    BlockSkipList &operator=(const BlockSkipList &) = delete;
+
+    template <typename U>
+    const T *find(U &&data);
+
+    template <typename U>
+    bool insert(U &&data);
+    // 用args构造数据并插入：只有一个参数时先用它查重，确认不重复后才构造
+    template <typename... Args>
+    bool emplace(Args &&...args);
+
+    template <typename U>
+    bool remove(U &&data);
+
+    // 获取data的排名(从0开始)，不存在时返回-1
+    template <typename U>
+    long getRank(U &&data);
+    // 获取排名为rank的数据，rank为负数时从尾部倒数，越界时返回nullptr
+    const T *getByRank(long rank);
+    // 获取排名在[start, stop]内的数据，start/stop为负数时从尾部倒数
+    void rangeByRank(long start, long stop, std::vector<const T *> &result);
+
+    const_iterator begin() const { return {m_head, 0, this}; }
+    const_iterator end() const { return {nullptr, 0, this}; }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator{end()}; }
+    const_reverse_iterator rend() const { return const_reverse_iterator{begin()}; }
+    // 第一个不小于data的位置
+    template <typename U>
+    const_iterator lower_bound(U &&data);
+    // 第一个大于data的位置
+    template <typename U>
+    const_iterator upper_bound(U &&data);
+
+    size_type size() const { return m_length; }
+    bool empty() const { return m_length == 0; }
+
+    // 清空所有数据
+    void clear();
+    // 用有序数据[first, last)重建跳表，一次线性遍历完成，除最后一块外每块都是满的，重复数据只保留一个；
+    // balanced为true时按块的序号确定层高，否则随机生成层高
+    template <typename InputIt>
+    void buildFromSorted(InputIt first, InputIt last, bool balanced = false);
+    // 批量插入/删除[first, last)，返回成功插入/删除的个数
+    template <typename InputIt>
+    unsigned long insertBatch(InputIt first, InputIt last);
+    template <typename InputIt>
+    unsigned long removeBatch(InputIt first, InputIt last);
+
+protected:
+    // 层高上限
+    const static unsigned char MAX_LEVEL = LevelGen::MAX_LEVEL;
+    // 删除后块内数据少于MERGE_THRESHOLD个时尝试与后继合并，合并后不超过MERGE_LIMIT个，避免马上又分裂
+    const static unsigned int MERGE_THRESHOLD = BlockSize / 4;
+    const static unsigned int MERGE_LIMIT = BlockSize * 3 / 4;
+
+    // 比较器定义了is_transparent时，可以直接用任意能与T比较的类型查找
+    const static bool IS_TRANSPARENT = SkipListIsTransparent<CmpLess>::value;
+    // 查找参数的实际类型，与SkipList3相同
+    template <typename U>
+    using KeyArg = typename std::conditional<IS_TRANSPARENT || std::is_same<typename std::decay<U>::type, T>::value, U &&, T>::type;
+
+    // 有符号的32/64位整数按默认顺序比较时，块内查找使用SIMD指令
+    const static bool SIMD_SEARCH = std::is_integral<T>::value && std::is_signed<T>::value &&
+                                    (sizeof(T) == sizeof(int32_t) || sizeof(T) == sizeof(int64_t)) &&
+                                    (std::is_same<CmpLess, std::less<T>>::value || std::is_same<CmpLess, std::less<>>::value);
+
+    // 用户数据比较: a < b
+    template <typename U, typename V>
+    bool customDataLess(U &&a, V &&b) { return m_cmpLess(a, b); }
+    // 用户数据比较: a == b
+    template <typename U, typename V>
+    bool customDataEqual(U &&a, V &&b) { return !m_cmpLess(a, b) && !m_cmpLess(b, a); }
+
+    // 生成节点层高
+    unsigned char genLevel() { return m_levelGen(); }
+
+    // 有level层的节点占用的内存大小
+    static size_t nodeSize(unsigned char level) { return sizeof(BlockNode) + (level - 1) * sizeof(SkipLevel); }
+    // 创建有level层的空节点
+    BlockNode *createNode(unsigned char level);
+    // 释放节点
+    void releaseNode(BlockNode *node);
+    // 释放包括头节点在内的所有节点
+    void releaseAllNodes();
+
+    // 块内小于data的数据个数
+    template <typename U>
+    unsigned int countLess(const BlockNode *node, const U &data);
+
+    // 找到各层最后一个第一个数据小于data的节点(头节点视为小于任何数据)，
+    // rankArray为这些节点之前的数据个数
+    template <typename U>
+    BlockNode *findLastLessThan(U &&data, BlockNode **updateArray, unsigned long *rankArray);
+    // 定位data应在的块：返回该块，*index为块内第一个不小于data的位置，*nodeRank为该块之前的数据个数；
+    // 返回的块在第0层的后继时，updateArray是它在各层的前驱，否则它在自己的各层上就是updateArray
+    template <typename U>
+    BlockNode *locate(U &&data, BlockNode **updateArray, unsigned long *rankArray, unsigned int *index, unsigned long *nodeRank);
+    // 找到排名为rank(从0开始)的数据所在的块，*index为块内位置
+    BlockNode *findByRank(unsigned long rank, unsigned int *index);
+
+    // 第i层上跨过node的那一段的起点：node在第i层时是node自己，否则是updateArray[i]
+    static BlockNode *levelOwner(BlockNode *node, BlockNode **updateArray, int i) { return i < node->m_level ? node : updateArray[i]; }
+    // 块内数据个数变化delta后修正各层跨度
+    void adjustSpan(BlockNode *node, BlockNode **updateArray, long delta);
+    // 把node末尾的moveCount个数据移到新节点，新节点链接在node之后，nodeRank为node之前的数据个数
+    BlockNode *splitNode(BlockNode *node, unsigned int moveCount, BlockNode **updateArray, unsigned long *rankArray, unsigned long nodeRank);
+    // 把node在第0层的后继合并到node中并释放后继
+    void mergeNext(BlockNode *node, BlockNode **updateArray);
+    // 将空节点从各层摘除并释放，updateArray为node在各层的前驱
+    void unlinkNode(BlockNode *node, BlockNode **updateArray);
+
+    // 用户数据比较对象
+    CmpLess m_cmpLess;
+    // 节点内存分配器
+    Allocator m_allocator;
+    // 层高生成策略
+    LevelGen m_levelGen;
+
+    BlockNode *m_head = nullptr;
+    // 最后一个块，没有数据时是头节点
+    BlockNode *m_tail = nullptr;
+
+    // 当前的最大层高
+    unsigned char m_level = 0;
+    // 数据总数
+    unsigned long m_length = 0;
+};
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::ConstIterator::ConstIterator(const BlockNode *node, unsigned int index, const BlockSkipList *skipList)
+    : m_node{node}, m_index{index}, m_skipList{skipList}
+{
+    if (m_node && m_index == m_node->m_count)
+    {
+        m_node = m_node->m_levelArray[0].m_next;
+        m_index = 0;
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+typename BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::ConstIterator &BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::ConstIterator::operator++()
+{
+    if (++m_index == m_node->m_count)
+    {
+        m_node = m_node->m_levelArray[0].m_next;
+        m_index = 0;
+    }
+    return *this;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+typename BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::ConstIterator &BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::ConstIterator::operator--()
+{
+    if (m_node && m_index)
+    {
+        --m_index;
+        return *this;
+    }
+
+    // 只有头节点可能为空，它之前没有数据，不会后退到空块
+    m_node = m_node ? m_node->m_prev : m_skipList->m_tail;
+    m_index = m_node->m_count - 1;
+    return *this;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::BlockSkipList(const LevelGen &levelGen)
+    : m_levelGen{levelGen}
+{
+    m_head = createNode(MAX_LEVEL);
+    m_tail = m_head;
+    m_level = 1;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::~BlockSkipList()
+{
+    releaseAllNodes();
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+template <typename U>
+const T *BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::find(U &&data)
+{
+    BlockNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    unsigned int index;
+    unsigned long nodeRank;
+    KeyArg<U> key(std::forward<U>(data));
+
+    auto node = locate(key, updateArray, rankArray, &index, &nodeRank);
+    if (index < node->m_count && customDataEqual(node->m_dataArray[index], key))
+    {
+        return &node->m_dataArray[index];
+    }
+
+    return nullptr;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+template <typename U>
+bool BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::insert(U &&data)
+{
+    BlockNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    unsigned int index;
+    unsigned long nodeRank;
+    KeyArg<U> key(std::forward<U>(data));
+
+    auto node = locate(key, updateArray, rankArray, &index, &nodeRank);
+    if (index < node->m_count && customDataEqual(node->m_dataArray[index], key))
+    {
+        return false;
+    }
+
+    if (node->m_count == BlockSize)
+    {
+        // 在最后一块的末尾追加时新块只放新数据，顺序插入时除最后一块外都是满的
+        auto moveCount = node == m_tail && index == BlockSize ? 0 : BlockSize / 2;
+        auto newNode = splitNode(node, moveCount, updateArray, rankArray, nodeRank);
+        if (index > node->m_count || (index == node->m_count && !moveCount))
+        {
+            // 新块以上各层跨过它的段与跨过原块的段相同
+            for (auto i = newNode->m_level; i < m_level; ++i)
+            {
+                updateArray[i] = levelOwner(node, updateArray, i);
+            }
+            index -= node->m_count;
+            node = newNode;
+        }
+    }
+
+    auto dataArray = node->m_dataArray;
+    std::move_backward(dataArray + index, dataArray + node->m_count, dataArray + node->m_count + 1);
+    dataArray[index] = T(std::forward<KeyArg<U>>(key));
+    ++node->m_count;
+
+    adjustSpan(node, updateArray, 1);
+    m_length++;
+
+    return true;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+template <typename... Args>
+bool BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::emplace(Args &&...args)
+{
+    if constexpr (sizeof...(Args) == 1)
+    {
+        return insert(std::forward<Args>(args)...);
+    }
+    else
+    {
+        // 数据存放在块内，多个构造参数只能先构造临时对象再移入块中
+        return insert(T(std::forward<Args>(args)...));
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+template <typename U>
+bool BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::remove(U &&data)
+{
+    BlockNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    unsigned int index;
+    unsigned long nodeRank;
+    KeyArg<U> key(std::forward<U>(data));
+
+    auto node = locate(key, updateArray, rankArray, &index, &nodeRank);
+    if (index >= node->m_count || !customDataEqual(node->m_dataArray[index], key))
+    {
+        return false;
+    }
+
+    auto dataArray = node->m_dataArray;
+    std::move(dataArray + index + 1, dataArray + node->m_count, dataArray + index);
+    --node->m_count;
+    // 释放移出的数据可能持有的资源
+    dataArray[node->m_count] = T();
+
+    adjustSpan(node, updateArray, -1);
+    m_length--;
+
+    if (node != m_head && !node->m_count)
+    {
+        // 块只剩一个数据时它就是块的第一个数据，locate返回的是后继块，updateArray是各层前驱
+        unlinkNode(node, updateArray);
+    }
+    else if (node->m_count < MERGE_THRESHOLD)
+    {
+        auto nextNode = node->m_levelArray[0].m_next;
+        if (nextNode && node->m_count + nextNode->m_count <= MERGE_LIMIT)
+        {
+            mergeNext(node, updateArray);
+        }
+    }
+
+    return true;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+template <typename U>
+long BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::getRank(U &&data)
+{
+    BlockNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    unsigned int index;
+    unsigned long nodeRank;
+    KeyArg<U> key(std::forward<U>(data));
+
+    auto node = locate(key, updateArray, rankArray, &index, &nodeRank);
+    if (index >= node->m_count || !customDataEqual(node->m_dataArray[index], key))
+    {
+        return -1;
+    }
+
+    return nodeRank + index;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+const T *BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::getByRank(long rank)
+{
+    if (rank < 0)
+    {
+        rank += m_length;
+    }
+    if (rank < 0 || rank >= (long)m_length)
+    {
+        return nullptr;
+    }
+
+    unsigned int index;
+    auto node = findByRank(rank, &index);
+    return &node->m_dataArray[index];
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+void BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::rangeByRank(long start, long stop, std::vector<const T *> &result)
+{
+    result.clear();
+
+    if (start < 0)
+    {
+        start += m_length;
+    }
+    if (stop < 0)
+    {
+        stop += m_length;
+    }
+    if (start < 0)
+    {
+        start = 0;
+    }
+    if (stop >= (long)m_length)
+    {
+        stop = m_length - 1;
+    }
+    if (start > stop)
+    {
+        return;
+    }
+
+    result.reserve(stop - start + 1);
+    unsigned int index;
+    auto node = findByRank(start, &index);
+    for (auto i = start; i <= stop; ++i)
+    {
+        result.push_back(&node->m_dataArray[index]);
+        if (++index == node->m_count)
+        {
+            node = node->m_levelArray[0].m_next;
+            index = 0;
+        }
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+template <typename U>
+typename BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::const_iterator BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::lower_bound(U &&data)
+{
+    BlockNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    unsigned int index;
+    unsigned long nodeRank;
+    KeyArg<U> key(std::forward<U>(data));
+
+    auto node = locate(key, updateArray, rankArray, &index, &nodeRank);
+
+    return {node, index, this};
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+template <typename U>
+typename BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::const_iterator BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::upper_bound(U &&data)
+{
+    BlockNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    unsigned int index;
+    unsigned long nodeRank;
+    KeyArg<U> key(std::forward<U>(data));
+
+    auto node = locate(key, updateArray, rankArray, &index, &nodeRank);
+
+    // 数据不重复，等于data的数据最多一个
+    if (index < node->m_count && customDataEqual(node->m_dataArray[index], key))
+    {
+        ++index;
+    }
+
+    return {node, index, this};
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+void BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::clear()
+{
+    releaseAllNodes();
+
+    m_head = createNode(MAX_LEVEL);
+    m_tail = m_head;
+    m_level = 1;
+    m_length = 0;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+template <typename InputIt>
+void BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::buildFromSorted(InputIt first, InputIt last, bool balanced)
+{
+    clear();
+
+    // 每层当前的最后一个节点及其之前的数据个数
+    BlockNode *lastArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    for (auto i = 0; i < MAX_LEVEL; ++i)
+    {
+        lastArray[i] = m_head;
+        rankArray[i] = 0;
+    }
+
+    unsigned long nodeCount = 0;
+    for (; first != last; ++first)
+    {
+        const T &data = *first;
+        auto tailNode = lastArray[0];
+        if (m_length)
+        {
+            const T &lastData = tailNode->m_dataArray[tailNode->m_count - 1];
+            if (!m_cmpLess(lastData, data))
+            {
+                if (!m_cmpLess(data, lastData))
+                {
+                    continue;
+                }
+
+                // 乱序数据：补齐各层末尾的跨度后退化为普通插入，再重新定位各层末尾节点
+                for (auto i = 0; i < m_level; ++i)
+                {
+                    lastArray[i]->m_levelArray[i].m_span = m_length - rankArray[i];
+                }
+                m_tail = tailNode;
+
+                insert(data);
+
+                auto curNode = m_head;
+                unsigned long curRank = 0;
+                for (auto i = MAX_LEVEL; i > 0; --i)
+                {
+                    while (curNode->m_levelArray[i - 1].m_next)
+                    {
+                        curRank += curNode->m_levelArray[i - 1].m_span;
+                        curNode = curNode->m_levelArray[i - 1].m_next;
+                    }
+                    lastArray[i - 1] = curNode;
+                    rankArray[i - 1] = curRank;
+                }
+                continue;
+            }
+        }
+
+        if (tailNode->m_count == BlockSize)
+        {
+            auto level = balanced ? LevelGen::rankLevel(++nodeCount) : genLevel();
+            auto newNode = createNode(level);
+            newNode->m_prev = tailNode;
+
+            for (auto i = 0; i < level; ++i)
+            {
+                auto &prevNodeLevel = lastArray[i]->m_levelArray[i];
+                prevNodeLevel.m_next = newNode;
+                prevNodeLevel.m_span = m_length - rankArray[i];
+
+                lastArray[i] = newNode;
+                rankArray[i] = m_length;
+            }
+
+            if (level > m_level)
+            {
+                m_level = level;
+            }
+
+            tailNode = newNode;
+        }
+
+        tailNode->m_dataArray[tailNode->m_count++] = data;
+        m_length++;
+    }
+
+    for (auto i = 0; i < m_level; ++i)
+    {
+        lastArray[i]->m_levelArray[i].m_span = m_length - rankArray[i];
+    }
+    m_tail = lastArray[0];
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+template <typename InputIt>
+unsigned long BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::insertBatch(InputIt first, InputIt last)
+{
+    unsigned long count = 0;
+    for (; first != last; ++first)
+    {
+        count += insert(*first);
+    }
+    return count;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+template <typename InputIt>
+unsigned long BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::removeBatch(InputIt first, InputIt last)
+{
+    unsigned long count = 0;
+    for (; first != last; ++first)
+    {
+        count += remove(*first);
+    }
+    return count;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+typename BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::BlockNode *BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::createNode(unsigned char level)
+{
+    auto memory = m_allocator.allocate(nodeSize(level), level);
+    auto node = new (memory) BlockNode;
+    node->m_level = level;
+    for (auto i = 1; i < level; ++i)
+    {
+        new (&node->m_levelArray[i]) SkipLevel;
+    }
+    return node;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+void BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::releaseNode(BlockNode *node)
+{
+    if (!node)
+        return;
+    auto level = node->m_level;
+    node->~BlockNode();
+    m_allocator.deallocate(node, nodeSize(level), level);
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+void BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::releaseAllNodes()
+{
+    if (Allocator::BULK_RELEASE)
+    {
+        // 节点内存由分配器整体释放，这里只需析构用户数据
+        if (!std::is_trivially_destructible<T>::value)
+        {
+            while (m_head)
+            {
+                auto node = m_head;
+                m_head = m_head->m_levelArray[0].m_next;
+                node->~BlockNode();
+            }
+        }
+        m_allocator.releaseAll();
+        m_head = nullptr;
+        return;
+    }
+
+    while (m_head)
+    {
+        auto node = m_head;
+        m_head = m_head->m_levelArray[0].m_next;
+        releaseNode(node);
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+template <typename U>
+unsigned int BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::countLess(const BlockNode *node, const U &data)
+{
+    if constexpr (SIMD_SEARCH && std::is_same<typename std::decay<U>::type, T>::value)
+    {
+        return BlockSkipListSimd::countLess<T>(node->m_dataArray, node->m_count, data);
+    }
+    else
+    {
+        auto dataArray = node->m_dataArray;
+        return std::lower_bound(dataArray, dataArray + node->m_count, data,
+                                [this](const T &a, const U &b)
+                                { return customDataLess(a, b); }) -
+               dataArray;
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+template <typename U>
+typename BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::BlockNode *BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::findLastLessThan(U &&data, BlockNode **updateArray, unsigned long *rankArray)
+{
+    auto curNode = m_head;
+    auto curLevel = m_level;
+
+    rankArray[curLevel - 1] = 0;
+    while (curLevel)
+    {
+        if (curLevel < m_level)
+        {
+            rankArray[curLevel - 1] = rankArray[curLevel];
+        }
+
+        auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        while (nextNode &&
+               customDataLess(nextNode->m_dataArray[0], data))
+        {
+            rankArray[curLevel - 1] += curNode->m_levelArray[curLevel - 1].m_span;
+            curNode = nextNode;
+            nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        }
+
+        updateArray[curLevel - 1] = curNode;
+
+        --curLevel;
+    }
+
+    return curNode;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+template <typename U>
+typename BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::BlockNode *BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::locate(U &&data, BlockNode **updateArray, unsigned long *rankArray, unsigned int *index, unsigned long *nodeRank)
+{
+    auto node = findLastLessThan(data, updateArray, rankArray);
+
+    // 后继块的第一个数据不小于data，等于时data就在后继块的开头
+    auto nextNode = node->m_levelArray[0].m_next;
+    if (nextNode && !customDataLess(data, nextNode->m_dataArray[0]))
+    {
+        *index = 0;
+        *nodeRank = rankArray[0] + node->m_count;
+        return nextNode;
+    }
+
+    *index = countLess(node, data);
+    *nodeRank = rankArray[0];
+    return node;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+typename BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::BlockNode *BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::findByRank(unsigned long rank, unsigned int *index)
+{
+    auto curNode = m_head;
+    auto curLevel = m_level;
+    unsigned long curRank = 0;
+
+    while (curLevel)
+    {
+        auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        while (nextNode && curRank + curNode->m_levelArray[curLevel - 1].m_span <= rank)
+        {
+            curRank += curNode->m_levelArray[curLevel - 1].m_span;
+            curNode = nextNode;
+            nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        }
+
+        --curLevel;
+    }
+
+    *index = rank - curRank;
+    return curNode;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+void BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::adjustSpan(BlockNode *node, BlockNode **updateArray, long delta)
+{
+    for (auto i = 0; i < m_level; ++i)
+    {
+        levelOwner(node, updateArray, i)->m_levelArray[i].m_span += delta;
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+typename BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::BlockNode *BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::splitNode(BlockNode *node, unsigned int moveCount, BlockNode **updateArray, unsigned long *rankArray, unsigned long nodeRank)
+{
+    auto level = genLevel();
+    auto newNode = createNode(level);
+
+    auto dataArray = node->m_dataArray;
+    node->m_count -= moveCount;
+    std::move(dataArray + node->m_count, dataArray + node->m_count + moveCount, newNode->m_dataArray);
+    newNode->m_count = moveCount;
+
+    if (level > m_level)
+    {
+        for (auto i = m_level; i < level; ++i)
+        {
+            updateArray[i] = m_head;
+            updateArray[i]->m_levelArray[i].m_span = m_length;
+            rankArray[i] = 0;
+        }
+        m_level = level;
+    }
+
+    // 新块之前的数据个数
+    auto newRank = nodeRank + node->m_count;
+    for (auto i = 0; i < level; ++i)
+    {
+        auto prevNode = levelOwner(node, updateArray, i);
+        auto prevRank = prevNode == node ? nodeRank : rankArray[i];
+        auto &newNodeLevel = newNode->m_levelArray[i];
+        auto &prevNodeLevel = prevNode->m_levelArray[i];
+
+        newNodeLevel.m_next = prevNodeLevel.m_next;
+        prevNodeLevel.m_next = newNode;
+
+        newNodeLevel.m_span = prevRank + prevNodeLevel.m_span - newRank;
+        prevNodeLevel.m_span = newRank - prevRank;
+    }
+
+    newNode->m_prev = node;
+    if (newNode->m_levelArray[0].m_next)
+    {
+        newNode->m_levelArray[0].m_next->m_prev = newNode;
+    }
+    else
+    {
+        m_tail = newNode;
+    }
+
+    return newNode;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+void BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::mergeNext(BlockNode *node, BlockNode **updateArray)
+{
+    auto nextNode = node->m_levelArray[0].m_next;
+
+    std::move(nextNode->m_dataArray, nextNode->m_dataArray + nextNode->m_count, node->m_dataArray + node->m_count);
+    node->m_count += nextNode->m_count;
+
+    // 后继的数据并入node后仍在跨过node的段内，只需把后继所在各层的段接上
+    for (auto i = 0; i < nextNode->m_level; ++i)
+    {
+        auto &prevNodeLevel = levelOwner(node, updateArray, i)->m_levelArray[i];
+        prevNodeLevel.m_next = nextNode->m_levelArray[i].m_next;
+        prevNodeLevel.m_span += nextNode->m_levelArray[i].m_span;
+    }
+
+    if (nextNode->m_levelArray[0].m_next)
+    {
+        nextNode->m_levelArray[0].m_next->m_prev = node;
+    }
+    else
+    {
+        m_tail = node;
+    }
+
+    releaseNode(nextNode);
+
+    while (m_level > 1 && m_head->m_levelArray[m_level - 1].m_next == nullptr)
+    {
+        --m_level;
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen, unsigned int BlockSize>
+void BlockSkipList<T, CmpLess, Allocator, LevelGen, BlockSize>::unlinkNode(BlockNode *node, BlockNode **updateArray)
+{
+    for (auto i = 0; i < node->m_level; ++i)
+    {
+        auto &prevNodeLevel = updateArray[i]->m_levelArray[i];
+        prevNodeLevel.m_next = node->m_levelArray[i].m_next;
+        prevNodeLevel.m_span += node->m_levelArray[i].m_span;
+    }
+
+    if (node->m_levelArray[0].m_next)
+    {
+        node->m_levelArray[0].m_next->m_prev = node->m_prev;
+    }
+    else
+    {
+        m_tail = node->m_prev;
+    }
+
+    releaseNode(node);
+
+    while (m_level > 1 && m_head->m_levelArray[m_level - 1].m_next == nullptr)
+    {
+        --m_level;
+    }
+}
+
+#endif // _BLOCK_SKIPLIST_H_
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include "ConcurrentSkipList.h"
+#include "SkipList3.h"
+
+// 用全局互斥锁包装的SkipList3，作为吞吐量对比的基准
+template <typename T>
+class MutexSkipList
+{
+public:
+    bool find(const T &data)
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_skipList.find(data) != nullptr;
+    }
+
+    bool insert(const T &data)
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_skipList.insert(data);
+    }
+
+    bool remove(const T &data)
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_skipList.remove(data);
+    }
+
+private:
+    std::mutex m_mutex;
+    SkipList<T> m_skipList;
+};
+
+// 消耗操作结果，避免查找被编译器优化掉
+static std::atomic<unsigned long> s_sink{0};
+
+// xorshift64，避免rand()的全局锁影响测试
+static unsigned long long nextRandom(unsigned long long &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// 压力测试：
+// 每个线程在只属于自己的键上随机插入/删除并记录期望结果，同时在所有线程共享的小范围键上制造冲突，
+// 结束后检查跳表内容与各线程记录的并集一致，且共享键的插入成功次数减删除成功次数等于剩余个数
+static bool stressTest(int threadCount, int opCount)
+{
+    const int SHARED_KEYS = 64;
+
+    ConcurrentSkipList<int> skipList;
+    std::vector<std::set<int>> expectedArray(threadCount);
+    std::vector<long> sharedBalanceArray(threadCount, 0);
+    // 各线程私有键的操作结果与模型不一致时置1
+    std::vector<char> failedArray(threadCount, 0);
+
+    std::vector<std::thread> threadArray;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threadArray.emplace_back([&, t]()
+                                 {
+            unsigned long long state = 0x2545f4914f6cdd1dull * (t + 1);
+            auto &expected = expectedArray[t];
+            for (int i = 0; i < opCount; ++i)
+            {
+                auto random = nextRandom(state);
+                if (random % 4 == 0)
+                {
+                    // 共享键
+                    int key = -1 - (int)(random / 4 % SHARED_KEYS);
+                    if (random / 256 % 2)
+                    {
+                        sharedBalanceArray[t] += skipList.insert(key);
+                    }
+                    else
+                    {
+                        sharedBalanceArray[t] -= skipList.remove(key);
+                    }
+                    continue;
+                }
+
+                // 线程私有的键
+                int key = (int)(random / 4 % 1024) * threadCount + t;
+                switch (random / 4096 % 3)
+                {
+                case 0:
+                    if (skipList.insert(key) != expected.insert(key).second)
+                    {
+                        printf("insert mismatch %d\n", key);
+                        failedArray[t] = 1;
+                    }
+                    break;
+                case 1:
+                    if (skipList.remove(key) != (expected.erase(key) > 0))
+                    {
+                        printf("remove mismatch %d\n", key);
+                        failedArray[t] = 1;
+                    }
+                    break;
+                default:
+                    if (skipList.find(key) != (expected.count(key) > 0))
+                    {
+                        printf("find mismatch %d\n", key);
+                        failedArray[t] = 1;
+                    }
+                    break;
+                }
+            } });
+    }
+    for (auto &thread : threadArray)
+    {
+        thread.join();
+    }
+
+    std::set<int> expected;
+    long sharedBalance = 0;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        expected.insert(expectedArray[t].begin(), expectedArray[t].end());
+        sharedBalance += sharedBalanceArray[t];
+    }
+
+    std::vector<int> actual;
+    skipList.forEach([&](int data)
+                     { actual.push_back(data); });
+
+    long sharedCount = 0;
+    auto it = expected.begin();
+    bool ok = true;
+    for (auto data : actual)
+    {
+        if (data < 0)
+        {
+            ++sharedCount;
+            continue;
+        }
+        if (it == expected.end() || *it != data)
+        {
+            ok = false;
+            break;
+        }
+        ++it;
+    }
+    ok = ok && it == expected.end() && sharedCount == sharedBalance;
+    ok = ok && std::none_of(failedArray.begin(), failedArray.end(), [](char failed)
+                            { return failed != 0; });
+
+    printf("stress %d threads: %s (%zu keys, %zu pending reclaim)\n",
+           threadCount, ok ? "ok" : "FAILED", actual.size(), skipList.retiredCount());
+    return ok;
+}
+
+// 吞吐量测试：预先填充一半的键，各线程执行find:insert:remove = 8:1:1的随机操作
+template <typename SkipListType>
+static double throughput(int threadCount, int opCount)
+{
+    const int KEY_RANGE = 1 << 20;
+
+    SkipListType skipList;
+    for (int i = 0; i < KEY_RANGE; i += 2)
+    {
+        skipList.insert(i);
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threadArray;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threadArray.emplace_back([&, t]()
+                                 {
+            unsigned long long state = 0x9e3779b97f4a7c15ull * (t + 1);
+            unsigned long successCount = 0;
+            for (int i = 0; i < opCount; ++i)
+            {
+                auto random = nextRandom(state);
+                int key = (int)(random % KEY_RANGE);
+                switch (random / KEY_RANGE % 10)
+                {
+                case 0:
+                    successCount += skipList.insert(key);
+                    break;
+                case 1:
+                    successCount += skipList.remove(key);
+                    break;
+                default:
+                    successCount += skipList.find(key);
+                    break;
+                }
+            }
+            s_sink.fetch_add(successCount, std::memory_order_relaxed); });
+    }
+    for (auto &thread : threadArray)
+    {
+        thread.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return threadCount * (double)opCount / elapsed.count();
+}
+
+int main()
+{
+    printf("begin\n");
+
+    bool ok = true;
+    for (int threadCount : {1, 2, 4, 8})
+    {
+        ok = stressTest(threadCount, 200000) && ok;
+    }
+
+    const int OP_COUNT = 500000;
+    printf("%8s %16s %16s\n", "threads", "lock-free ops/s", "mutex ops/s");
+    for (int threadCount : {1, 2, 4, 8, 16})
+    {
+        auto lockFree = throughput<ConcurrentSkipList<int>>(threadCount, OP_COUNT);
+        auto mutex = throughput<MutexSkipList<int>>(threadCount, OP_COUNT);
+        printf("%8d %16.0f %16.0f\n", threadCount, lockFree, mutex);
+    }
+
+    printf("end\n");
+
+    return ok ? 0 : 1;
+}
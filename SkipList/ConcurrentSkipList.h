@@ -0,0 +1,394 @@
+#ifndef _CONCURRENT_SKIPLIST_H_
+#define _CONCURRENT_SKIPLIST_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <utility>
+#include "EpochReclaimer.h"
+#include "SkipListLevelGen.h"
+
+// 无锁跳表：
+// 每层的后继指针最低位作为删除标记，删除时自顶向下标记各层，标记第0层成功的线程即为删除者；
+// 插入时先用CAS链接第0层(线性化点)，再自底向上逐层链接。
+// 查找过程中遇到已标记的节点会顺手将其从该层摘除，节点通过EpochReclaimer延迟释放。
+template <typename T, class CmpLess = std::less<T>>
+class ConcurrentSkipList
+{
+protected:
+    struct SkipNode
+    {
+        template <typename... Args>
+        explicit SkipNode(Args &&...args) : m_data(std::forward<Args>(args)...) {}
+
+        T m_data;
+        // 插入/删除完成标志，两者都完成的线程负责回收节点
+        std::atomic<unsigned char> m_state{0};
+        // 节点层高
+        unsigned char m_level = 0;
+        // 各层后继，最低位为删除标记，与节点一次分配，实际长度为节点层高
+        std::atomic<uintptr_t> m_nextArray[1];
+    };
+
+public:
+    ConcurrentSkipList();
+    // 要求此时没有其它线程访问跳表
+    ~ConcurrentSkipList();
+
+    ConcurrentSkipList(const ConcurrentSkipList &) = delete;
+    ConcurrentSkipList &operator=(const ConcurrentSkipList &) = delete;
+
+    // 查找data，找到时将数据复制到result(可以为nullptr)
+    template <typename U>
+    bool find(U &&data, T *result = nullptr);
+
+    template <typename U>
+    bool insert(U &&data);
+
+    template <typename U>
+    bool remove(U &&data);
+
+    // 按顺序遍历所有未删除的数据，与并发修改同时进行时只保证弱一致性
+    template <typename F>
+    void forEach(F &&func);
+
+    // 待回收的节点数
+    size_t retiredCount() const { return m_reclaimer.retiredCount(); }
+
+protected:
+    // 层高上限
+    const static unsigned char MAX_LEVEL = 32;
+
+    // 节点状态标志
+    const static unsigned char INSERT_DONE = 1;
+    const static unsigned char REMOVE_DONE = 2;
+
+    static bool isMarked(uintptr_t next) { return next & 1; }
+    static SkipNode *toNode(uintptr_t next) { return reinterpret_cast<SkipNode *>(next & ~uintptr_t(1)); }
+    static uintptr_t toNext(SkipNode *node) { return reinterpret_cast<uintptr_t>(node); }
+
+    // 用户数据比较: a < b
+    template <typename U, typename V>
+    bool customDataLess(U &&a, V &&b) { return m_cmpLess(a, b); }
+    // 用户数据比较: a == b
+    template <typename U, typename V>
+    bool customDataEqual(U &&a, V &&b) { return !m_cmpLess(a, b) && !m_cmpLess(b, a); }
+
+    // 生成节点层高
+    unsigned char genLevel() { return m_levelGen(); }
+
+    // 创建有level层的节点，用args原地构造数据
+    template <typename... Args>
+    static SkipNode *createNode(unsigned char level, Args &&...args);
+    // 析构节点中的数据并释放节点
+    static void releaseNode(void *node);
+
+    // 找到每层最后一个小于data的节点及其后继，同时摘除沿途已标记删除的节点；
+    // 第0层的后继等于data时返回true
+    template <typename U>
+    bool findLastLessThan(U &&data, SkipNode **predArray, SkipNode **succArray);
+
+    // 标记节点的插入或删除已完成，两者都完成时摘除并回收节点
+    void finishNode(SkipNode *node, unsigned char state, SkipNode **predArray, SkipNode **succArray);
+
+    // 用户数据比较对象
+    CmpLess m_cmpLess;
+
+    // 层高生成器，使用线程局部的随机数发生器
+    SkipListLevelGen<MAX_LEVEL> m_levelGen;
+
+    EpochReclaimer m_reclaimer;
+
+    SkipNode *m_head = nullptr;
+
+    // 出现过的最大层高，只增不减，用于跳过空的高层
+    std::atomic<unsigned char> m_level{1};
+};
+
+template <typename T, class CmpLess>
+ConcurrentSkipList<T, CmpLess>::ConcurrentSkipList()
+{
+    m_head = createNode(MAX_LEVEL);
+}
+
+template <typename T, class CmpLess>
+ConcurrentSkipList<T, CmpLess>::~ConcurrentSkipList()
+{
+    // 此时所有节点都已完成插入/删除，已回收的节点不会出现在第0层
+    auto node = m_head;
+    while (node)
+    {
+        auto next = toNode(node->m_nextArray[0].load(std::memory_order_relaxed));
+        releaseNode(node);
+        node = next;
+    }
+}
+
+template <typename T, class CmpLess>
+template <typename U>
+bool ConcurrentSkipList<T, CmpLess>::find(U &&data, T *result)
+{
+    EpochReclaimer::Guard guard{m_reclaimer};
+
+    // 只读查找，不摘除节点
+    auto predNode = m_head;
+    SkipNode *curNode = nullptr;
+    for (auto curLevel = m_level.load(std::memory_order_acquire); curLevel; --curLevel)
+    {
+        curNode = toNode(predNode->m_nextArray[curLevel - 1].load(std::memory_order_acquire));
+        while (curNode)
+        {
+            auto next = curNode->m_nextArray[curLevel - 1].load(std::memory_order_acquire);
+            if (isMarked(next))
+            {
+                curNode = toNode(next);
+                continue;
+            }
+
+            if (!customDataLess(curNode->m_data, data))
+            {
+                break;
+            }
+
+            predNode = curNode;
+            curNode = toNode(next);
+        }
+    }
+
+    if (!curNode || !customDataEqual(curNode->m_data, data))
+    {
+        return false;
+    }
+
+    if (result)
+    {
+        *result = curNode->m_data;
+    }
+
+    return true;
+}
+
+template <typename T, class CmpLess>
+template <typename U>
+bool ConcurrentSkipList<T, CmpLess>::insert(U &&data)
+{
+    EpochReclaimer::Guard guard{m_reclaimer};
+
+    SkipNode *predArray[MAX_LEVEL];
+    SkipNode *succArray[MAX_LEVEL];
+
+    auto level = genLevel();
+    auto curLevel = m_level.load(std::memory_order_relaxed);
+    while (curLevel < level && !m_level.compare_exchange_weak(curLevel, level, std::memory_order_acq_rel))
+    {
+    }
+
+    if (findLastLessThan(data, predArray, succArray))
+    {
+        return false;
+    }
+
+    auto newNode = createNode(level, std::forward<U>(data));
+
+    while (true)
+    {
+        for (auto i = 0; i < level; ++i)
+        {
+            newNode->m_nextArray[i].store(toNext(succArray[i]), std::memory_order_relaxed);
+        }
+
+        auto expected = toNext(succArray[0]);
+        if (predArray[0]->m_nextArray[0].compare_exchange_strong(expected, toNext(newNode), std::memory_order_acq_rel))
+        {
+            break;
+        }
+
+        if (findLastLessThan(newNode->m_data, predArray, succArray))
+        {
+            // 节点尚未发布，可以直接释放
+            releaseNode(newNode);
+            return false;
+        }
+    }
+
+    // 自底向上链接其余各层，节点被并发删除时停止
+    for (auto i = 1; i < level; ++i)
+    {
+        while (true)
+        {
+            auto next = newNode->m_nextArray[i].load(std::memory_order_acquire);
+            if (isMarked(next))
+            {
+                i = level;
+                break;
+            }
+            if (next != toNext(succArray[i]) &&
+                !newNode->m_nextArray[i].compare_exchange_strong(next, toNext(succArray[i]), std::memory_order_acq_rel))
+            {
+                i = level;
+                break;
+            }
+
+            auto expected = toNext(succArray[i]);
+            if (predArray[i]->m_nextArray[i].compare_exchange_strong(expected, toNext(newNode), std::memory_order_acq_rel))
+            {
+                break;
+            }
+
+            findLastLessThan(newNode->m_data, predArray, succArray);
+            if (succArray[0] != newNode)
+            {
+                i = level;
+                break;
+            }
+        }
+    }
+
+    finishNode(newNode, INSERT_DONE, predArray, succArray);
+
+    return true;
+}
+
+template <typename T, class CmpLess>
+template <typename U>
+bool ConcurrentSkipList<T, CmpLess>::remove(U &&data)
+{
+    EpochReclaimer::Guard guard{m_reclaimer};
+
+    SkipNode *predArray[MAX_LEVEL];
+    SkipNode *succArray[MAX_LEVEL];
+
+    if (!findLastLessThan(data, predArray, succArray))
+    {
+        return false;
+    }
+
+    auto node = succArray[0];
+    for (auto i = node->m_level; i > 1; --i)
+    {
+        node->m_nextArray[i - 1].fetch_or(1, std::memory_order_acq_rel);
+    }
+
+    auto next = node->m_nextArray[0].load(std::memory_order_acquire);
+    while (true)
+    {
+        if (isMarked(next))
+        {
+            return false;
+        }
+        if (node->m_nextArray[0].compare_exchange_weak(next, next | 1, std::memory_order_acq_rel))
+        {
+            break;
+        }
+    }
+
+    finishNode(node, REMOVE_DONE, predArray, succArray);
+
+    return true;
+}
+
+template <typename T, class CmpLess>
+template <typename F>
+void ConcurrentSkipList<T, CmpLess>::forEach(F &&func)
+{
+    EpochReclaimer::Guard guard{m_reclaimer};
+
+    auto node = toNode(m_head->m_nextArray[0].load(std::memory_order_acquire));
+    while (node)
+    {
+        auto next = node->m_nextArray[0].load(std::memory_order_acquire);
+        if (!isMarked(next))
+        {
+            func(node->m_data);
+        }
+        node = toNode(next);
+    }
+}
+
+template <typename T, class CmpLess>
+template <typename... Args>
+typename ConcurrentSkipList<T, CmpLess>::SkipNode *ConcurrentSkipList<T, CmpLess>::createNode(unsigned char level, Args &&...args)
+{
+    auto memory = ::operator new(sizeof(SkipNode) + (level - 1) * sizeof(std::atomic<uintptr_t>));
+    auto node = new (memory) SkipNode(std::forward<Args>(args)...);
+    node->m_level = level;
+    node->m_nextArray[0].store(0, std::memory_order_relaxed);
+    for (auto i = 1; i < level; ++i)
+    {
+        new (&node->m_nextArray[i]) std::atomic<uintptr_t>(0);
+    }
+    return node;
+}
+
+template <typename T, class CmpLess>
+void ConcurrentSkipList<T, CmpLess>::releaseNode(void *node)
+{
+    if (!node)
+        return;
+    static_cast<SkipNode *>(node)->~SkipNode();
+    ::operator delete(node);
+}
+
+template <typename T, class CmpLess>
+template <typename U>
+bool ConcurrentSkipList<T, CmpLess>::findLastLessThan(U &&data, SkipNode **predArray, SkipNode **succArray)
+{
+retry:
+    auto predNode = m_head;
+    auto level = m_level.load(std::memory_order_acquire);
+    for (auto i = level; i < MAX_LEVEL; ++i)
+    {
+        predArray[i] = m_head;
+        succArray[i] = nullptr;
+    }
+
+    for (auto curLevel = level; curLevel; --curLevel)
+    {
+        auto curNode = toNode(predNode->m_nextArray[curLevel - 1].load(std::memory_order_acquire));
+        while (curNode)
+        {
+            auto next = curNode->m_nextArray[curLevel - 1].load(std::memory_order_acquire);
+            if (isMarked(next))
+            {
+                // 摘除已标记的节点，前驱已变化时重新查找
+                auto expected = toNext(curNode);
+                if (!predNode->m_nextArray[curLevel - 1].compare_exchange_strong(expected, next & ~uintptr_t(1), std::memory_order_acq_rel))
+                {
+                    goto retry;
+                }
+                curNode = toNode(next);
+                continue;
+            }
+
+            if (!customDataLess(curNode->m_data, data))
+            {
+                break;
+            }
+
+            predNode = curNode;
+            curNode = toNode(next);
+        }
+
+        predArray[curLevel - 1] = predNode;
+        succArray[curLevel - 1] = curNode;
+    }
+
+    return succArray[0] && customDataEqual(succArray[0]->m_data, data);
+}
+
+template <typename T, class CmpLess>
+void ConcurrentSkipList<T, CmpLess>::finishNode(SkipNode *node, unsigned char state, SkipNode **predArray, SkipNode **succArray)
+{
+    if ((node->m_state.fetch_or(state, std::memory_order_acq_rel) | state) != (INSERT_DONE | REMOVE_DONE))
+    {
+        return;
+    }
+
+    // 插入方不再链接新的层，重新查找一次即可将节点从所有层摘除
+    findLastLessThan(node->m_data, predArray, succArray);
+    m_reclaimer.retire(node, releaseNode);
+}
+
+#endif // _CONCURRENT_SKIPLIST_H_
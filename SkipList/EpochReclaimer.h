@@ -0,0 +1,224 @@
+#ifndef _EPOCH_RECLAIMER_H_
+#define _EPOCH_RECLAIMER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+// 线程槽位：每个线程第一次使用时领取一个全局唯一的编号，线程退出时归还
+class EpochThreadSlot
+{
+public:
+    // 同时存活的线程数上限
+    const static unsigned int MAX_THREADS = 128;
+
+    static unsigned int id()
+    {
+        thread_local EpochThreadSlot slot;
+        return slot.m_id;
+    }
+
+private:
+    EpochThreadSlot();
+    ~EpochThreadSlot();
+
+    static std::atomic<bool> *usedArray()
+    {
+        static std::atomic<bool> s_usedArray[MAX_THREADS];
+        return s_usedArray;
+    }
+
+    unsigned int m_id = 0;
+};
+
+// 基于epoch的延迟回收：
+// 线程在访问共享节点前进入临界区并登记当前的全局epoch，被摘除的节点带着摘除时的epoch放入
+// 本线程的待回收链表；只有当所有处于临界区的线程都已登记了当前epoch时全局epoch才能前进，
+// 因此全局epoch比节点的epoch大2以上时，不会再有线程持有该节点，可以安全释放。
+class EpochReclaimer
+{
+public:
+    using Deleter = void (*)(void *);
+
+    // 临界区守卫，可以嵌套
+    class Guard
+    {
+    public:
+        explicit Guard(EpochReclaimer &reclaimer) : m_reclaimer{reclaimer} { m_reclaimer.enter(); }
+        ~Guard() { m_reclaimer.leave(); }
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+    private:
+        EpochReclaimer &m_reclaimer;
+    };
+
+    EpochReclaimer() = default;
+    // 要求此时没有线程处于临界区，释放所有待回收的节点
+    ~EpochReclaimer();
+
+    EpochReclaimer(const EpochReclaimer &) = delete;
+    EpochReclaimer &operator=(const EpochReclaimer &) = delete;
+
+    // 进入/离开临界区
+    void enter();
+    void leave();
+
+    // 延迟释放已经摘除的节点，必须在临界区内调用
+    void retire(void *ptr, Deleter deleter);
+
+    // 当前待回收的节点数(近似值)
+    size_t retiredCount() const;
+
+protected:
+    // 登记的epoch最低位表示线程处于临界区
+    const static uint64_t ACTIVE = 1;
+    // 每新增阈值个待回收节点尝试推进一次epoch并回收
+    const static size_t RETIRE_THRESHOLD = 64;
+
+    struct Retired
+    {
+        void *m_ptr;
+        Deleter m_deleter;
+        uint64_t m_epoch;
+    };
+
+    struct alignas(64) ThreadRecord
+    {
+        // 线程登记的epoch
+        std::atomic<uint64_t> m_epoch{0};
+        // 临界区嵌套深度，仅本线程访问
+        unsigned int m_depth = 0;
+        // 距离上次尝试回收后新增的待回收节点数，仅本线程访问
+        size_t m_pendingCount = 0;
+        // 待回收链表，仅本线程访问
+        std::vector<Retired> m_retiredList;
+    };
+
+    // 所有处于临界区的线程都已登记当前epoch时推进全局epoch
+    void tryAdvance();
+    // 释放本线程可以安全回收的节点
+    void reclaim(ThreadRecord &record);
+
+    // 全局epoch，每次推进加2，最低位留给ACTIVE标志
+    std::atomic<uint64_t> m_globalEpoch{2};
+    std::atomic<size_t> m_retiredCount{0};
+    ThreadRecord m_recordArray[EpochThreadSlot::MAX_THREADS];
+};
+
+inline EpochThreadSlot::EpochThreadSlot()
+{
+    auto used = usedArray();
+    for (unsigned int i = 0; i < MAX_THREADS; ++i)
+    {
+        bool expected = false;
+        if (!used[i].load(std::memory_order_relaxed) &&
+            used[i].compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            m_id = i;
+            return;
+        }
+    }
+
+    // 线程数超过上限
+    abort();
+}
+
+inline EpochThreadSlot::~EpochThreadSlot()
+{
+    usedArray()[m_id].store(false, std::memory_order_release);
+}
+
+inline EpochReclaimer::~EpochReclaimer()
+{
+    for (auto &record : m_recordArray)
+    {
+        for (auto &retired : record.m_retiredList)
+        {
+            retired.m_deleter(retired.m_ptr);
+        }
+    }
+}
+
+inline void EpochReclaimer::enter()
+{
+    auto &record = m_recordArray[EpochThreadSlot::id()];
+    if (record.m_depth++)
+    {
+        return;
+    }
+
+    // 登记必须先于临界区内对共享节点的读取
+    record.m_epoch.store(m_globalEpoch.load(std::memory_order_relaxed) | ACTIVE, std::memory_order_seq_cst);
+}
+
+inline void EpochReclaimer::leave()
+{
+    auto &record = m_recordArray[EpochThreadSlot::id()];
+    if (--record.m_depth)
+    {
+        return;
+    }
+
+    record.m_epoch.store(0, std::memory_order_release);
+}
+
+inline void EpochReclaimer::retire(void *ptr, Deleter deleter)
+{
+    auto &record = m_recordArray[EpochThreadSlot::id()];
+    record.m_retiredList.push_back({ptr, deleter, m_globalEpoch.load(std::memory_order_seq_cst)});
+    m_retiredCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (++record.m_pendingCount >= RETIRE_THRESHOLD)
+    {
+        record.m_pendingCount = 0;
+        tryAdvance();
+        reclaim(record);
+    }
+}
+
+inline size_t EpochReclaimer::retiredCount() const
+{
+    return m_retiredCount.load(std::memory_order_relaxed);
+}
+
+inline void EpochReclaimer::tryAdvance()
+{
+    auto epoch = m_globalEpoch.load(std::memory_order_seq_cst);
+    for (auto &record : m_recordArray)
+    {
+        auto recordEpoch = record.m_epoch.load(std::memory_order_seq_cst);
+        if ((recordEpoch & ACTIVE) && (recordEpoch & ~ACTIVE) != epoch)
+        {
+            return;
+        }
+    }
+
+    m_globalEpoch.compare_exchange_strong(epoch, epoch + 2, std::memory_order_seq_cst);
+}
+
+inline void EpochReclaimer::reclaim(ThreadRecord &record)
+{
+    auto epoch = m_globalEpoch.load(std::memory_order_acquire);
+    auto &retiredList = record.m_retiredList;
+
+    size_t count = 0;
+    for (auto &retired : retiredList)
+    {
+        if (retired.m_epoch + 4 <= epoch)
+        {
+            retired.m_deleter(retired.m_ptr);
+        }
+        else
+        {
+            retiredList[count++] = retired;
+        }
+    }
+
+    m_retiredCount.fetch_sub(retiredList.size() - count, std::memory_order_relaxed);
+    retiredList.resize(count);
+}
+
+#endif // _EPOCH_RECLAIMER_H_
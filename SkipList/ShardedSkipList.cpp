@@ -0,0 +1,137 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <set>
+#include <thread>
+#include <vector>
+#include "ShardedSkipList.h"
+
+// 消耗操作结果，避免操作被编译器优化掉
+static std::atomic<unsigned long> s_sink{0};
+
+// xorshift64，避免rand()的全局锁影响测试
+static unsigned long long nextRandom(unsigned long long &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// 正确性检查：多线程插入/删除后，归并遍历、排名和范围查询与std::set一致
+static bool checkMerge(int threadCount, int opCount)
+{
+    ShardedSkipList<int> skipList;
+    std::vector<std::set<int>> expectedArray(threadCount);
+
+    std::vector<std::thread> threadArray;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threadArray.emplace_back([&, t]()
+                                 {
+            unsigned long long state = 0x2545f4914f6cdd1dull * (t + 1);
+            auto &expected = expectedArray[t];
+            for (int i = 0; i < opCount; ++i)
+            {
+                auto random = nextRandom(state);
+                // 每个线程只修改自己的键，结果可以与各自的记录对照
+                int key = (int)(random % 4096) * threadCount + t;
+                if (random / 4096 % 3)
+                {
+                    skipList.insert(key);
+                    expected.insert(key);
+                }
+                else
+                {
+                    skipList.remove(key);
+                    expected.erase(key);
+                }
+            } });
+    }
+    for (auto &thread : threadArray)
+    {
+        thread.join();
+    }
+
+    std::set<int> expected;
+    for (auto &threadExpected : expectedArray)
+    {
+        expected.insert(threadExpected.begin(), threadExpected.end());
+    }
+    std::vector<int> expectedArrayAll(expected.begin(), expected.end());
+
+    std::vector<int> actual;
+    skipList.forEach([&](int data)
+                     { actual.push_back(data); });
+    auto ok = actual == expectedArrayAll && skipList.size() == expected.size();
+
+    for (size_t i = 0; ok && i < expectedArrayAll.size(); i += 97)
+    {
+        int data;
+        ok = skipList.getRank(expectedArrayAll[i]) == (long)i && skipList.getByRank((long)i, &data) && data == expectedArrayAll[i];
+    }
+
+    std::vector<int> range;
+    skipList.rangeByRank(100, 199, range);
+    ok = ok && std::equal(range.begin(), range.end(), expectedArrayAll.begin() + 100, expectedArrayAll.begin() + 200);
+
+    skipList.rangeByValue(1000, 5000, range);
+    ok = ok && std::equal(range.begin(), range.end(), expected.lower_bound(1000), expected.lower_bound(5000));
+
+    printf("merge %d threads: %s (%zu keys, %zu shards)\n", threadCount, ok ? "ok" : "FAILED", actual.size(), skipList.shardCount());
+    return ok;
+}
+
+// 写入吞吐量：各线程插入互不相同的随机键
+static double insertThroughput(size_t shardCount, int threadCount, int opCount)
+{
+    ShardedSkipList<long long> skipList{shardCount};
+
+    auto begin = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threadArray;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threadArray.emplace_back([&, t]()
+                                 {
+            unsigned long long state = 0x9e3779b97f4a7c15ull * (t + 1);
+            unsigned long successCount = 0;
+            for (int i = 0; i < opCount; ++i)
+            {
+                successCount += skipList.insert((long long)(nextRandom(state) >> 8) * threadCount + t);
+            }
+            s_sink.fetch_add(successCount, std::memory_order_relaxed); });
+    }
+    for (auto &thread : threadArray)
+    {
+        thread.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    return threadCount * (double)opCount / elapsed.count();
+}
+
+int main()
+{
+    printf("begin\n");
+
+    bool ok = true;
+    for (int threadCount : {1, 4, 8})
+    {
+        ok = checkMerge(threadCount, 100000) && ok;
+    }
+
+    // 单分片即所有线程共用一把锁，作为对比的基准
+    const int OP_COUNT = 200000;
+    printf("%8s %16s %16s\n", "threads", "sharded ops/s", "1 shard ops/s");
+    for (int threadCount : {1, 2, 4, 8, 16, 32})
+    {
+        auto sharded = insertThroughput(0, threadCount, OP_COUNT);
+        auto single = insertThroughput(1, threadCount, OP_COUNT);
+        printf("%8d %16.0f %16.0f\n", threadCount, sharded, single);
+    }
+
+    printf("end\n");
+
+    return ok ? 0 : 1;
+}
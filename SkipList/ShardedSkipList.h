@@ -0,0 +1,372 @@
+#ifndef _SHARDED_SKIPLIST_H_
+#define _SHARDED_SKIPLIST_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "SkipList3.h"
+
+// 分片跳表：
+// 按哈希把数据分到N个独立的SkipList3分片，每个分片有自己的锁和节点分配器，
+// 单个数据的查找/插入/删除只锁一个分片，不同分片上的写入互不影响。
+// 有序遍历、范围查询和排名查询需要所有分片的数据，按分片顺序锁住全部分片后对各分片做k路归并，
+// 单个数据的操作只持有一个锁，因此不会死锁。
+template <typename T, class CmpLess = std::less<T>, class Hash = std::hash<T>,
+          class Allocator = SkipListPoolAllocator, class LevelGen = SkipListLevelGen<>>
+class ShardedSkipList
+{
+public:
+    using ShardList = SkipList<T, CmpLess, Allocator, LevelGen>;
+
+    // shardCount为0时按硬件线程数的4倍分片，降低多个线程落到同一分片的概率
+    explicit ShardedSkipList(size_t shardCount = 0);
+
+    ShardedSkipList(const ShardedSkipList &) = delete;
+    ShardedSkipList &operator=(const ShardedSkipList &) = delete;
+
+    // 查找data，找到时将数据复制到result(可以为nullptr)
+    template <typename U>
+    bool find(U &&data, T *result = nullptr);
+
+    template <typename U>
+    bool insert(U &&data);
+
+    template <typename U>
+    bool remove(U &&data);
+
+    // 获取data的排名(从0开始)，即各分片中小于data的数据个数之和，不存在时返回-1
+    template <typename U>
+    long getRank(U &&data);
+    // 获取排名为rank的数据，rank为负数时从尾部倒数，越界时返回false
+    bool getByRank(long rank, T *result);
+    // 获取排名在[start, stop]内的数据，start/stop为负数时从尾部倒数
+    void rangeByRank(long start, long stop, std::vector<T> &result);
+    // 获取[low, high)内的数据
+    template <typename U, typename V>
+    void rangeByValue(const U &low, const V &high, std::vector<T> &result);
+    // 按顺序遍历所有数据，遍历期间锁住全部分片，func中不能再访问本对象
+    template <typename F>
+    void forEach(F &&func);
+
+    size_t size();
+    size_t shardCount() const { return m_shardCount; }
+
+protected:
+    // 分片按缓存行对齐，避免相邻分片的锁伪共享
+    struct alignas(64) Shard
+    {
+        std::mutex m_mutex;
+        ShardList m_skipList;
+    };
+
+    using ShardIterator = typename ShardList::const_iterator;
+    // 归并中的一个分片：当前位置和结束位置
+    using MergeCursor = std::pair<ShardIterator, ShardIterator>;
+
+    // 在作用域内按顺序锁住全部分片
+    class AllShardLock
+    {
+    public:
+        explicit AllShardLock(ShardedSkipList *shardedSkipList) : m_shardedSkipList{shardedSkipList}
+        {
+            for (size_t i = 0; i < m_shardedSkipList->m_shardCount; ++i)
+            {
+                m_shardedSkipList->m_shardArray[i].m_mutex.lock();
+            }
+        }
+        ~AllShardLock()
+        {
+            for (size_t i = m_shardedSkipList->m_shardCount; i > 0; --i)
+            {
+                m_shardedSkipList->m_shardArray[i - 1].m_mutex.unlock();
+            }
+        }
+
+        AllShardLock(const AllShardLock &) = delete;
+        AllShardLock &operator=(const AllShardLock &) = delete;
+
+    private:
+        ShardedSkipList *m_shardedSkipList;
+    };
+
+    // data所在的分片：标准库中整数的哈希是恒等映射，先乘以黄金分割常数打散，再用高32位按比例映射到分片
+    template <typename U>
+    Shard &shardOf(const U &data) const
+    {
+        auto hash = (uint64_t)m_hash(data) * 0x9e3779b97f4a7c15ull;
+        return m_shardArray[(size_t)(((hash >> 32) * m_shardCount) >> 32)];
+    }
+
+    // 已锁住全部分片时的总数据个数
+    size_t lockedSize() const;
+    // 已锁住全部分片时把负数排名换算为正数，越界时返回false
+    bool normalizeRank(long &start, long &stop) const;
+    // 对cursorArray中各分片的剩余数据做k路归并，按顺序对每个数据调用func，func返回false时停止
+    template <typename F>
+    void merge(std::vector<MergeCursor> &cursorArray, F &&func) const;
+
+    size_t m_shardCount;
+    std::unique_ptr<Shard[]> m_shardArray;
+    CmpLess m_cmpLess;
+    Hash m_hash;
+};
+
+template <typename T, class CmpLess, class Hash, class Allocator, class LevelGen>
+ShardedSkipList<T, CmpLess, Hash, Allocator, LevelGen>::ShardedSkipList(size_t shardCount)
+{
+    if (shardCount == 0)
+    {
+        shardCount = std::max(1u, std::thread::hardware_concurrency()) * 4;
+    }
+
+    m_shardCount = shardCount;
+    m_shardArray.reset(new Shard[shardCount]);
+}
+
+template <typename T, class CmpLess, class Hash, class Allocator, class LevelGen>
+template <typename U>
+bool ShardedSkipList<T, CmpLess, Hash, Allocator, LevelGen>::find(U &&data, T *result)
+{
+    auto &shard = shardOf(data);
+    std::lock_guard<std::mutex> lock{shard.m_mutex};
+
+    auto found = shard.m_skipList.find(std::forward<U>(data));
+    if (found && result)
+    {
+        *result = *found;
+    }
+
+    return found != nullptr;
+}
+
+template <typename T, class CmpLess, class Hash, class Allocator, class LevelGen>
+template <typename U>
+bool ShardedSkipList<T, CmpLess, Hash, Allocator, LevelGen>::insert(U &&data)
+{
+    auto &shard = shardOf(data);
+    std::lock_guard<std::mutex> lock{shard.m_mutex};
+    return shard.m_skipList.insert(std::forward<U>(data));
+}
+
+template <typename T, class CmpLess, class Hash, class Allocator, class LevelGen>
+template <typename U>
+bool ShardedSkipList<T, CmpLess, Hash, Allocator, LevelGen>::remove(U &&data)
+{
+    auto &shard = shardOf(data);
+    std::lock_guard<std::mutex> lock{shard.m_mutex};
+    return shard.m_skipList.remove(std::forward<U>(data));
+}
+
+template <typename T, class CmpLess, class Hash, class Allocator, class LevelGen>
+template <typename U>
+long ShardedSkipList<T, CmpLess, Hash, Allocator, LevelGen>::getRank(U &&data)
+{
+    AllShardLock lock{this};
+
+    // 数据只可能在自己的分片中，其他分片只需统计比它小的个数
+    auto &owner = shardOf(data);
+    auto rank = owner.m_skipList.getRank(data);
+    if (rank < 0)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < m_shardCount; ++i)
+    {
+        if (&m_shardArray[i] != &owner)
+        {
+            rank += m_shardArray[i].m_skipList.countLess(data);
+        }
+    }
+
+    return rank;
+}
+
+template <typename T, class CmpLess, class Hash, class Allocator, class LevelGen>
+bool ShardedSkipList<T, CmpLess, Hash, Allocator, LevelGen>::getByRank(long rank, T *result)
+{
+    AllShardLock lock{this};
+
+    auto stop = rank;
+    if (!normalizeRank(rank, stop))
+    {
+        return false;
+    }
+
+    std::vector<MergeCursor> cursorArray;
+    for (size_t i = 0; i < m_shardCount; ++i)
+    {
+        cursorArray.emplace_back(m_shardArray[i].m_skipList.begin(), m_shardArray[i].m_skipList.end());
+    }
+
+    merge(cursorArray, [&](const T &data)
+          {
+        if (rank-- > 0)
+        {
+            return true;
+        }
+        *result = data;
+        return false; });
+
+    return true;
+}
+
+template <typename T, class CmpLess, class Hash, class Allocator, class LevelGen>
+void ShardedSkipList<T, CmpLess, Hash, Allocator, LevelGen>::rangeByRank(long start, long stop, std::vector<T> &result)
+{
+    result.clear();
+
+    AllShardLock lock{this};
+
+    if (!normalizeRank(start, stop))
+    {
+        return;
+    }
+
+    std::vector<MergeCursor> cursorArray;
+    for (size_t i = 0; i < m_shardCount; ++i)
+    {
+        cursorArray.emplace_back(m_shardArray[i].m_skipList.begin(), m_shardArray[i].m_skipList.end());
+    }
+
+    result.reserve(stop - start + 1);
+    long rank = 0;
+    merge(cursorArray, [&](const T &data)
+          {
+        if (rank >= start)
+        {
+            result.push_back(data);
+        }
+        return ++rank <= stop; });
+}
+
+template <typename T, class CmpLess, class Hash, class Allocator, class LevelGen>
+template <typename U, typename V>
+void ShardedSkipList<T, CmpLess, Hash, Allocator, LevelGen>::rangeByValue(const U &low, const V &high, std::vector<T> &result)
+{
+    result.clear();
+
+    AllShardLock lock{this};
+
+    // 各分片先定位到第一个不小于low的位置，之后的归并不再比较low
+    std::vector<MergeCursor> cursorArray;
+    for (size_t i = 0; i < m_shardCount; ++i)
+    {
+        auto &skipList = m_shardArray[i].m_skipList;
+        auto first = skipList.lower_bound(low);
+        if (first != skipList.end())
+        {
+            cursorArray.emplace_back(first, skipList.end());
+        }
+    }
+
+    merge(cursorArray, [&](const T &data)
+          {
+        if (!m_cmpLess(data, high))
+        {
+            return false;
+        }
+        result.push_back(data);
+        return true; });
+}
+
+template <typename T, class CmpLess, class Hash, class Allocator, class LevelGen>
+template <typename F>
+void ShardedSkipList<T, CmpLess, Hash, Allocator, LevelGen>::forEach(F &&func)
+{
+    AllShardLock lock{this};
+
+    std::vector<MergeCursor> cursorArray;
+    for (size_t i = 0; i < m_shardCount; ++i)
+    {
+        cursorArray.emplace_back(m_shardArray[i].m_skipList.begin(), m_shardArray[i].m_skipList.end());
+    }
+
+    merge(cursorArray, [&](const T &data)
+          {
+        func(data);
+        return true; });
+}
+
+template <typename T, class CmpLess, class Hash, class Allocator, class LevelGen>
+size_t ShardedSkipList<T, CmpLess, Hash, Allocator, LevelGen>::size()
+{
+    AllShardLock lock{this};
+    return lockedSize();
+}
+
+template <typename T, class CmpLess, class Hash, class Allocator, class LevelGen>
+size_t ShardedSkipList<T, CmpLess, Hash, Allocator, LevelGen>::lockedSize() const
+{
+    size_t size = 0;
+    for (size_t i = 0; i < m_shardCount; ++i)
+    {
+        size += m_shardArray[i].m_skipList.size();
+    }
+    return size;
+}
+
+template <typename T, class CmpLess, class Hash, class Allocator, class LevelGen>
+bool ShardedSkipList<T, CmpLess, Hash, Allocator, LevelGen>::normalizeRank(long &start, long &stop) const
+{
+    long length = (long)lockedSize();
+    if (start < 0)
+    {
+        start += length;
+    }
+    if (stop < 0)
+    {
+        stop += length;
+    }
+    if (start < 0)
+    {
+        start = 0;
+    }
+    if (stop >= length)
+    {
+        stop = length - 1;
+    }
+
+    return start <= stop;
+}
+
+template <typename T, class CmpLess, class Hash, class Allocator, class LevelGen>
+template <typename F>
+void ShardedSkipList<T, CmpLess, Hash, Allocator, LevelGen>::merge(std::vector<MergeCursor> &cursorArray, F &&func) const
+{
+    cursorArray.erase(std::remove_if(cursorArray.begin(), cursorArray.end(), [](const MergeCursor &cursor)
+                                     { return cursor.first == cursor.second; }),
+                      cursorArray.end());
+
+    // 小顶堆，堆顶为当前最小的分片
+    auto greater = [this](const MergeCursor &a, const MergeCursor &b)
+    { return m_cmpLess(*b.first, *a.first); };
+    std::make_heap(cursorArray.begin(), cursorArray.end(), greater);
+
+    while (!cursorArray.empty())
+    {
+        std::pop_heap(cursorArray.begin(), cursorArray.end(), greater);
+        auto &cursor = cursorArray.back();
+        if (!func(*cursor.first))
+        {
+            return;
+        }
+
+        if (++cursor.first == cursor.second)
+        {
+            cursorArray.pop_back();
+        }
+        else
+        {
+            std::push_heap(cursorArray.begin(), cursorArray.end(), greater);
+        }
+    }
+}
+
+#endif
@@ -1,7 +1,186 @@
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
 #include "SkipList1.h"
+#include "SkipListFile.h"
 
-SkipList::SkipList(CmpFunc cmpFunc)
-    : m_cmpFunc{cmpFunc}
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// 快照文件格式(本机字节序)：
+// 文件头SnapshotHeader，之后是按顺序排列的记录，每条记录为8字节score、4字节member长度和member的内容
+static const char SNAPSHOT_MAGIC[8] = {'S', 'K', 'L', 'S', 'N', 'A', 'P', '\0'};
+static const uint32_t SNAPSHOT_VERSION = 1;
+// 记录中score和member长度占用的字节数
+static const size_t SNAPSHOT_RECORD_HEADER_SIZE = sizeof(int64_t) + sizeof(uint32_t);
+// 保存时的写缓冲区大小
+static const size_t SNAPSHOT_BUFFER_SIZE = 1 << 16;
+
+struct SnapshotHeader
+{
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_reserved;
+    // 记录条数
+    uint64_t m_count;
+    // 记录部分的字节数
+    uint64_t m_payloadSize;
+    // 记录部分的校验和，以m_count为初值
+    uint64_t m_checksum;
+};
+
+// 集合运算中每个线程至少处理的节点数，节点少时开线程的开销超过收益；
+// 编译本文件时可以用SKIPLIST_SET_OP_PARALLEL_GRAIN改小，用SKIPLIST_SET_OP_THREADS指定线程数上限，
+// 使小数据在单核机器上也走并行路径，供测试使用
+#ifndef SKIPLIST_SET_OP_PARALLEL_GRAIN
+#define SKIPLIST_SET_OP_PARALLEL_GRAIN (1 << 16)
+#endif
+static const size_t SET_OP_PARALLEL_GRAIN = SKIPLIST_SET_OP_PARALLEL_GRAIN;
+
+// 处理count个节点使用的线程数
+static unsigned setOpThreadCount(size_t count)
+{
+#ifdef SKIPLIST_SET_OP_THREADS
+    size_t threadCount = SKIPLIST_SET_OP_THREADS;
+#else
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+#endif
+    return (unsigned)std::min(threadCount, std::max<size_t>(1, count / SET_OP_PARALLEL_GRAIN));
+}
+
+// 分段并行排序，再逐轮把相邻的两段并行归并为一段
+template <typename Less>
+static void parallelSort(std::vector<std::pair<long long, void *>> &array, Less less)
+{
+    auto threadCount = setOpThreadCount(array.size());
+    if (threadCount <= 1)
+    {
+        std::sort(array.begin(), array.end(), less);
+        return;
+    }
+
+    std::vector<size_t> boundArray(threadCount + 1);
+    for (unsigned t = 0; t <= threadCount; ++t)
+    {
+        boundArray[t] = array.size() * t / threadCount;
+    }
+
+    std::vector<std::thread> threadArray;
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+        threadArray.emplace_back([&array, &boundArray, less, t]()
+                                 { std::sort(array.begin() + boundArray[t], array.begin() + boundArray[t + 1], less); });
+    }
+    for (auto &thread : threadArray)
+    {
+        thread.join();
+    }
+
+    for (unsigned step = 1; step < threadCount; step *= 2)
+    {
+        threadArray.clear();
+        for (unsigned t = 0; t + step < threadCount; t += 2 * step)
+        {
+            auto first = array.begin() + boundArray[t];
+            auto middle = array.begin() + boundArray[t + step];
+            auto last = array.begin() + boundArray[std::min(t + 2 * step, threadCount)];
+            threadArray.emplace_back([first, middle, last, less]()
+                                     { std::inplace_merge(first, middle, last, less); });
+        }
+        for (auto &thread : threadArray)
+        {
+            thread.join();
+        }
+    }
+}
+
+// 按aggregate合并同一data两侧的score
+static long long aggregateScore(SkipList::Aggregate aggregate, long long a, long long b)
+{
+    switch (aggregate)
+    {
+    case SkipList::Aggregate::MIN:
+        return std::min(a, b);
+    case SkipList::Aggregate::MAX:
+        return std::max(a, b);
+    default:
+        return a + b;
+    }
+}
+
+// 将整个文件只读映射到内存，失败时返回nullptr
+static const unsigned char *mapFile(const char *path, size_t *size)
+{
+#ifdef _WIN32
+    auto file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+
+    LARGE_INTEGER fileSize;
+    void *data = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+    {
+        // 映射视图建立后即可关闭句柄
+        auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+        {
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+
+    *size = data ? (size_t)fileSize.QuadPart : 0;
+    return static_cast<const unsigned char *>(data);
+#else
+    auto fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        // 映射建立后即可关闭文件
+        data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    // 加载时顺序读取整个文件；advice是取值而不是标志位，不能按位或，需要分别设置
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    madvise(data, st.st_size, MADV_WILLNEED);
+    *size = st.st_size;
+    return static_cast<const unsigned char *>(data);
+#endif
+}
+
+static void unmapFile(const unsigned char *data, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap(const_cast<unsigned char *>(data), size);
+#endif
+}
+
+SkipList::SkipList(CmpFunc cmpFunc, uint64_t levelSeed)
+    : m_cmpFunc{cmpFunc}, m_levelGen{levelSeed}
 {
     m_head = createNode(MAX_LEVEL);
     m_level = 1;
@@ -24,67 +203,74 @@ bool SkipList::insert(long long score, void *data)
 
     findLastLessThan(score, data, updateArray, rankArray);
 
-    auto level = genLevel();
-    auto newNode = createNode(level);
+    auto newNode = createNode(genLevel());
     newNode->m_score = score;
     newNode->m_data = data;
+    linkNode(newNode, updateArray, rankArray);
 
-    if (level > m_level)
+    if (m_opLog)
     {
-        for (auto i = m_level; i < level; ++i)
-        {
-            updateArray[i] = m_head;
-            updateArray[i]->m_levelArray[i].m_span = m_length;
-            rankArray[i] = 0;
-        }
-        m_level = level;
+        logOp(SkipListOpLog::OP_INSERT, score, data);
     }
 
-    for (auto i = 0; i < level; ++i)
+    return true;
+}
+
+bool SkipList::remove(long long score, void *data)
+{
+    SkipNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+
+    findLastLessThan(score, data, updateArray, rankArray);
+
+    auto nextNode = updateArray[0]->m_levelArray[0].m_next;
+    if (!nextNode || nextNode->m_score != score || m_cmpFunc(nextNode->m_data, data) != 0)
     {
-        auto prevNode = updateArray[i];
-        auto &newNodeLevel = newNode->m_levelArray[i];
-        auto &prevNodeLevel = prevNode->m_levelArray[i];
+        return false;
+    }
 
-        newNodeLevel.m_next = prevNodeLevel.m_next;
-        prevNodeLevel.m_next = newNode;
+    unlinkNode(nextNode, updateArray);
+    if (m_opLog)
+    {
+        logOp(SkipListOpLog::OP_REMOVE, score, nextNode->m_data);
+    }
+    releaseNode(nextNode);
 
-        newNodeLevel.m_span = rankArray[i] + prevNodeLevel.m_span - rankArray[0];
-        prevNodeLevel.m_span = rankArray[0] - rankArray[i] + 1;
+    return true;
+}
 
-        if (i == 0)
-        {
-            if (!newNodeLevel.m_next)
-            {
-                m_tail = newNode;
-            }
-            else
-            {
-                newNodeLevel.m_next->m_prev = newNode;
-            }
+bool SkipList::updateScore(long long oldScore, void *data, long long newScore)
+{
+    SkipNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
 
-            if (prevNode == m_head)
-            {
-                newNode->m_prev = nullptr;
-            }
-            else
-            {
-                newNode->m_prev = prevNode;
-            }
-        }
+    findLastLessThan(oldScore, data, updateArray, rankArray);
+
+    auto node = updateArray[0]->m_levelArray[0].m_next;
+    if (!node || node->m_score != oldScore || m_cmpFunc(node->m_data, data) != 0)
+    {
+        return false;
     }
 
-    for (auto i = level; i < m_level; ++i)
+    if (scoreFitsInPlace(node, newScore))
     {
-        updateArray[i]->m_levelArray[i].m_span++;
+        node->m_score = newScore;
+    }
+    else
+    {
+        relinkNode(node, newScore, updateArray, rankArray);
     }
 
-    m_length++;
+    if (m_opLog)
+    {
+        logOp(SkipListOpLog::OP_REMOVE, oldScore, node->m_data);
+        logOp(SkipListOpLog::OP_INSERT, newScore, node->m_data);
+    }
 
     return true;
 }
 
-bool SkipList::remove(long long score, void *data)
+long SkipList::getRank(long long score, void *data)
 {
     SkipNode *updateArray[MAX_LEVEL];
     unsigned long rankArray[MAX_LEVEL];
@@ -93,92 +279,1071 @@ bool SkipList::remove(long long score, void *data)
 
     auto nextNode = updateArray[0]->m_levelArray[0].m_next;
     if (!nextNode || nextNode->m_score != score || m_cmpFunc(nextNode->m_data, data) != 0)
+    {
+        return -1;
+    }
+
+    return rankArray[0];
+}
+
+bool SkipList::getByRank(long rank, long long *score, void **data)
+{
+    if (rank < 0)
+    {
+        rank += m_length;
+    }
+    if (rank < 0 || rank >= (long)m_length)
     {
         return false;
     }
 
-    for (auto i = 0; i < m_level; ++i)
+    auto node = findByRank(rank + 1);
+    if (score)
     {
-        auto curNode = updateArray[i];
-        if (curNode->m_levelArray[i].m_next == nextNode)
+        *score = node->m_score;
+    }
+    if (data)
+    {
+        *data = node->m_data;
+    }
+
+    return true;
+}
+
+void SkipList::rangeByRank(long start, long stop, std::vector<std::pair<long long, void *>> &result)
+{
+    result.clear();
+
+    if (start < 0)
+    {
+        start += m_length;
+    }
+    if (stop < 0)
+    {
+        stop += m_length;
+    }
+    if (start < 0)
+    {
+        start = 0;
+    }
+    if (stop >= (long)m_length)
+    {
+        stop = m_length - 1;
+    }
+    if (start > stop)
+    {
+        return;
+    }
+
+    result.reserve(stop - start + 1);
+    auto node = findByRank(start + 1);
+    for (auto i = start; i <= stop; ++i)
+    {
+        result.emplace_back(node->m_score, node->m_data);
+        node = node->m_levelArray[0].m_next;
+    }
+}
+
+void SkipList::rangeByScore(const ScoreRange &range, std::vector<std::pair<long long, void *>> &result,
+                            unsigned long offset, long limit)
+{
+    result.clear();
+
+    unsigned long rank;
+    auto node = findFirstInRange(range, &rank);
+    if (!node)
+    {
+        return;
+    }
+
+    // 利用跨度直接跳过offset个节点
+    if (offset)
+    {
+        if (rank + offset > m_length)
         {
-            curNode->m_levelArray[i].m_next = nextNode->m_levelArray[i].m_next;
-            curNode->m_levelArray[i].m_span += nextNode->m_levelArray[i].m_span - 1;
+            return;
         }
-        else
+        node = findByRank(rank + offset);
+    }
+
+    while (node && limit && scoreLteMax(node->m_score, range))
+    {
+        result.emplace_back(node->m_score, node->m_data);
+        node = node->m_levelArray[0].m_next;
+        if (limit > 0)
         {
-            curNode->m_levelArray[i].m_span--;
+            --limit;
         }
     }
+}
+
+void SkipList::revRangeByScore(const ScoreRange &range, std::vector<std::pair<long long, void *>> &result,
+                               unsigned long offset, long limit)
+{
+    result.clear();
 
-    if (nextNode->m_levelArray[0].m_next)
+    unsigned long rank;
+    auto node = findLastInRange(range, &rank);
+    if (!node)
     {
-        nextNode->m_levelArray[0].m_next->m_prev = nextNode->m_prev;
+        return;
     }
-    else
+
+    if (offset)
     {
-        m_tail = nextNode->m_prev;
+        if (rank <= offset)
+        {
+            return;
+        }
+        node = findByRank(rank - offset);
     }
 
-    while (m_level > 1 && m_head->m_levelArray[m_level - 1].m_next == nullptr)
+    while (node && limit && scoreGteMin(node->m_score, range))
     {
-        --m_level;
+        result.emplace_back(node->m_score, node->m_data);
+        node = node->m_prev;
+        if (limit > 0)
+        {
+            --limit;
+        }
     }
+}
 
-    m_length--;
+unsigned long SkipList::count(const ScoreRange &range)
+{
+    unsigned long firstRank, lastRank;
+    if (!findFirstInRange(range, &firstRank) || !findLastInRange(range, &lastRank))
+    {
+        return 0;
+    }
 
-    releaseNode(nextNode);
+    return lastRank - firstRank + 1;
+}
 
-    return true;
+unsigned long SkipList::removeRangeByRank(long start, long stop, std::vector<std::pair<long long, void *>> *removed)
+{
+    if (start < 0)
+    {
+        start += m_length;
+    }
+    if (stop < 0)
+    {
+        stop += m_length;
+    }
+    if (start < 0)
+    {
+        start = 0;
+    }
+    if (stop >= (long)m_length)
+    {
+        stop = m_length - 1;
+    }
+    if (start > stop)
+    {
+        return 0;
+    }
+
+    releaseNodeList(detachRange(start + 1, stop + 1), removed);
+
+    return stop - start + 1;
 }
 
-unsigned char SkipList::genLevel()
+unsigned long SkipList::removeRangeByScore(const ScoreRange &range, std::vector<std::pair<long long, void *>> *removed)
 {
-    unsigned char level = 1;
-    while (level < MAX_LEVEL && rand() <= LEVEL_THRESHOLD)
-        ++level;
-    return level;
+    unsigned long firstRank, lastRank;
+    if (!findFirstInRange(range, &firstRank) || !findLastInRange(range, &lastRank))
+    {
+        return 0;
+    }
+
+    releaseNodeList(detachRange(firstRank, lastRank), removed);
+
+    return lastRank - firstRank + 1;
 }
 
-SkipList::SkipNode *SkipList::createNode(unsigned char level)
+unsigned long SkipList::popMin(unsigned long count, std::vector<std::pair<long long, void *>> &result)
 {
-    auto node = new SkipNode;
-    node->m_levelArray = new SkipLevel[level];
-    return node;
+    result.clear();
+    if (count > m_length)
+    {
+        count = m_length;
+    }
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    // 从排名1开始摘除时各层前驱都是头节点，一次查找只需定位末端
+    releaseNodeList(detachRange(1, count), &result);
+
+    return count;
 }
 
-void SkipList::releaseNode(SkipNode *node)
+unsigned long SkipList::popMax(unsigned long count, std::vector<std::pair<long long, void *>> &result)
 {
-    if (!node)
-        return;
-    delete[] node->m_levelArray;
-    delete node;
+    result.clear();
+    if (count > m_length)
+    {
+        count = m_length;
+    }
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    releaseNodeList(detachRange(m_length - count + 1, m_length), &result);
+    std::reverse(result.begin(), result.end());
+
+    return count;
 }
 
-void SkipList::findLastLessThan(long long score, void *data, SkipNode **updateArray, unsigned long *rankArray)
+void SkipList::unionWith(const SkipList &other, Aggregate aggregate, long long weight, long long otherWeight)
 {
-    auto curNode = m_head;
-    auto curLevel = m_level;
+    combineWith(other, SET_UNION, aggregate, weight, otherWeight);
+}
 
-    rankArray[curLevel - 1] = 0;
-    while (curLevel)
+void SkipList::intersectWith(const SkipList &other, Aggregate aggregate, long long weight, long long otherWeight)
+{
+    combineWith(other, SET_INTERSECT, aggregate, weight, otherWeight);
+}
+
+void SkipList::differenceWith(const SkipList &other, long long weight)
+{
+    combineWith(other, SET_DIFFERENCE, Aggregate::SUM, weight, 0);
+}
+
+bool SkipList::saveSnapshot(const char *path, DataToBytes dataToBytes) const
+{
+    std::string tmpPath = std::string(path) + ".tmp";
+    auto file = fopen(tmpPath.c_str(), "wb");
+    if (!file)
     {
-        if (curLevel < m_level)
+        return false;
+    }
+
+    SnapshotHeader header = {};
+    memcpy(header.m_magic, SNAPSHOT_MAGIC, sizeof header.m_magic);
+    header.m_version = SNAPSHOT_VERSION;
+    header.m_count = m_length;
+
+    // 先写入文件头占位，写完记录后回填长度和校验和
+    bool ok = fwrite(&header, sizeof header, 1, file) == 1;
+
+    std::vector<unsigned char> buffer;
+    buffer.reserve(SNAPSHOT_BUFFER_SIZE * 2);
+    uint64_t checksum = header.m_count;
+
+    auto append = [&buffer](const void *data, size_t size)
+    {
+        auto bytes = static_cast<const unsigned char *>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    };
+    auto flush = [&](size_t size)
+    {
+        checksum = skipListChecksum(checksum, buffer.data(), size);
+        ok = ok && fwrite(buffer.data(), 1, size, file) == size;
+        buffer.erase(buffer.begin(), buffer.begin() + size);
+    };
+
+    for (auto node = m_head->m_levelArray[0].m_next; node && ok; node = node->m_levelArray[0].m_next)
+    {
+        auto bytes = dataBytes(node->m_data, dataToBytes);
+        if (bytes.size() > UINT32_MAX)
         {
-            rankArray[curLevel - 1] = rankArray[curLevel];
+            ok = false;
+            break;
         }
 
-        auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
-        while (nextNode &&
+        int64_t score = node->m_score;
+        uint32_t length = (uint32_t)bytes.size();
+        append(&score, sizeof score);
+        append(&length, sizeof length);
+        append(bytes.data(), bytes.size());
+        header.m_payloadSize += SNAPSHOT_RECORD_HEADER_SIZE + length;
+
+        // 只写出8字节对齐的部分，保证分段计算的校验和与整体计算一致
+        if (buffer.size() >= SNAPSHOT_BUFFER_SIZE)
+        {
+            flush(buffer.size() & ~(sizeof(uint64_t) - 1));
+        }
+    }
+    flush(buffer.size());
+    header.m_checksum = checksum;
+
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof header, 1, file) == 1 && skipListSyncFile(file);
+    ok = fclose(file) == 0 && ok;
+    ok = ok && skipListReplaceFile(tmpPath.c_str(), path);
+    if (!ok)
+    {
+        ::remove(tmpPath.c_str());
+    }
+
+    return ok;
+}
+
+bool SkipList::loadSnapshot(const char *path, BytesToData bytesToData)
+{
+    if (m_length)
+    {
+        return false;
+    }
+
+    SnapshotFile file;
+    if (!file.open(path))
+    {
+        return false;
+    }
+
+    SkipNode *lastArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    beginAppend(lastArray, rankArray);
+
+    long long score;
+    std::string_view bytes;
+    while (file.next(&score, &bytes))
+    {
+        auto node = createNode(genLevel());
+        node->m_score = score;
+        node->m_data = bytesData(bytes, bytesToData);
+        appendNode(node, lastArray, rankArray);
+
+        if (m_opLog)
+        {
+            logOp(SkipListOpLog::OP_INSERT, score, node->m_data);
+        }
+    }
+
+    endAppend(lastArray, rankArray);
+
+    return true;
+}
+
+bool SkipList::attachOpLog(SkipListOpLog *opLog, DataToBytes dataToBytes, BytesToData bytesToData)
+{
+    // 重放时不能再写回日志
+    m_opLog = nullptr;
+    m_dataToBytes = dataToBytes;
+    m_bytesToData = bytesToData;
+    if (!opLog)
+    {
+        return true;
+    }
+
+    if (!opLog->open(replayOp, this))
+    {
+        return false;
+    }
+    m_opLog = opLog;
+
+    return true;
+}
+
+SkipListStats SkipList::stats() const
+{
+    SkipListStats stats;
+#ifdef SKIPLIST_STATS
+    stats.setCounters(m_counters);
+#endif
+    stats.m_length = m_length;
+    stats.countNodes(m_head, m_level, nodeSize);
+    stats.m_totalBytes = sizeof(*this) + nodeSize(MAX_LEVEL) + stats.m_nodeBytes;
+    return stats;
+}
+
+void SkipList::resetStats()
+{
+#ifdef SKIPLIST_STATS
+    m_counters = {};
+#endif
+}
+
+unsigned char SkipList::genLevel()
+{
+    return m_levelGen();
+}
+
+SkipList::SkipNode *SkipList::createNode(unsigned char level, size_t extraSize)
+{
+    auto memory = ::operator new(nodeSize(level) + extraSize);
+    auto node = new (memory) SkipNode;
+    node->m_level = level;
+    for (auto i = 1; i < level; ++i)
+    {
+        new (&node->m_levelArray[i]) SkipLevel;
+    }
+    return node;
+}
+
+void SkipList::releaseNode(SkipNode *node)
+{
+    if (!node)
+        return;
+    node->~SkipNode();
+    ::operator delete(node);
+}
+
+void SkipList::linkNode(SkipNode *newNode, SkipNode **updateArray, unsigned long *rankArray)
+{
+    auto level = newNode->m_level;
+
+    if (level > m_level)
+    {
+        for (auto i = m_level; i < level; ++i)
+        {
+            updateArray[i] = m_head;
+            updateArray[i]->m_levelArray[i].m_span = m_length;
+            rankArray[i] = 0;
+        }
+        m_level = level;
+    }
+
+    for (auto i = 0; i < level; ++i)
+    {
+        auto prevNode = updateArray[i];
+        auto &newNodeLevel = newNode->m_levelArray[i];
+        auto &prevNodeLevel = prevNode->m_levelArray[i];
+
+        newNodeLevel.m_next = prevNodeLevel.m_next;
+        prevNodeLevel.m_next = newNode;
+
+        newNodeLevel.m_span = rankArray[i] + prevNodeLevel.m_span - rankArray[0];
+        prevNodeLevel.m_span = rankArray[0] - rankArray[i] + 1;
+
+        if (i == 0)
+        {
+            if (!newNodeLevel.m_next)
+            {
+                m_tail = newNode;
+            }
+            else
+            {
+                newNodeLevel.m_next->m_prev = newNode;
+            }
+
+            if (prevNode == m_head)
+            {
+                newNode->m_prev = nullptr;
+            }
+            else
+            {
+                newNode->m_prev = prevNode;
+            }
+        }
+    }
+
+    for (auto i = level; i < m_level; ++i)
+    {
+        updateArray[i]->m_levelArray[i].m_span++;
+    }
+
+    m_length++;
+}
+
+void SkipList::unlinkNode(SkipNode *node, SkipNode **updateArray)
+{
+    for (auto i = 0; i < m_level; ++i)
+    {
+        auto curNode = updateArray[i];
+        if (curNode->m_levelArray[i].m_next == node)
+        {
+            curNode->m_levelArray[i].m_next = node->m_levelArray[i].m_next;
+            curNode->m_levelArray[i].m_span += node->m_levelArray[i].m_span - 1;
+        }
+        else
+        {
+            curNode->m_levelArray[i].m_span--;
+        }
+    }
+
+    if (node->m_levelArray[0].m_next)
+    {
+        node->m_levelArray[0].m_next->m_prev = node->m_prev;
+    }
+    else
+    {
+        m_tail = node->m_prev;
+    }
+
+    while (m_level > 1 && m_head->m_levelArray[m_level - 1].m_next == nullptr)
+    {
+        --m_level;
+    }
+
+    m_length--;
+}
+
+SkipList::SkipNode *SkipList::detachRange(unsigned long firstRank, unsigned long lastRank)
+{
+    // updateArray为各层最后一个排名小于firstRank的节点，lastArray为各层最后一个排名不大于lastRank的节点
+    SkipNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    SkipNode *lastArray[MAX_LEVEL];
+    unsigned long lastRankArray[MAX_LEVEL];
+
+    auto curNode = m_head;
+    unsigned long curRank = 0;
+    auto lastNode = m_head;
+    unsigned long curLastRank = 0;
+
+    for (auto curLevel = m_level; curLevel; --curLevel)
+    {
+        auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        while (nextNode && curRank + curNode->m_levelArray[curLevel - 1].m_span < firstRank)
+        {
+            curRank += curNode->m_levelArray[curLevel - 1].m_span;
+            curNode = nextNode;
+            nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        }
+        updateArray[curLevel - 1] = curNode;
+        rankArray[curLevel - 1] = curRank;
+
+        // lastNode始终不在curNode之前，从上一层的位置继续前进即可
+        nextNode = lastNode->m_levelArray[curLevel - 1].m_next;
+        while (nextNode && curLastRank + lastNode->m_levelArray[curLevel - 1].m_span <= lastRank)
+        {
+            curLastRank += lastNode->m_levelArray[curLevel - 1].m_span;
+            lastNode = nextNode;
+            nextNode = lastNode->m_levelArray[curLevel - 1].m_next;
+        }
+        lastArray[curLevel - 1] = lastNode;
+        lastRankArray[curLevel - 1] = curLastRank;
+    }
+
+    auto count = lastRank - firstRank + 1;
+    // 此时curNode和lastNode就是第0层的两端
+    auto firstNode = curNode->m_levelArray[0].m_next;
+
+    for (auto i = 0; i < m_level; ++i)
+    {
+        auto &prevNodeLevel = updateArray[i]->m_levelArray[i];
+        if (lastArray[i] == updateArray[i])
+        {
+            // 该层没有被摘除的节点
+            prevNodeLevel.m_span -= count;
+        }
+        else
+        {
+            auto &lastNodeLevel = lastArray[i]->m_levelArray[i];
+            prevNodeLevel.m_next = lastNodeLevel.m_next;
+            prevNodeLevel.m_span = lastRankArray[i] + lastNodeLevel.m_span - rankArray[i] - count;
+        }
+    }
+
+    auto nextNode = lastNode->m_levelArray[0].m_next;
+    if (nextNode)
+    {
+        nextNode->m_prev = firstNode->m_prev;
+    }
+    else
+    {
+        m_tail = firstNode->m_prev;
+    }
+    lastNode->m_levelArray[0].m_next = nullptr;
+
+    while (m_level > 1 && m_head->m_levelArray[m_level - 1].m_next == nullptr)
+    {
+        --m_level;
+    }
+
+    m_length -= count;
+
+    return firstNode;
+}
+
+void SkipList::releaseNodeList(SkipNode *node, std::vector<std::pair<long long, void *>> *removed)
+{
+    while (node)
+    {
+        auto nextNode = node->m_levelArray[0].m_next;
+        if (removed)
+        {
+            removed->emplace_back(node->m_score, node->m_data);
+        }
+        if (m_opLog)
+        {
+            logOp(SkipListOpLog::OP_REMOVE, node->m_score, node->m_data);
+        }
+        releaseNode(node);
+        node = nextNode;
+    }
+}
+
+void SkipList::combineWith(const SkipList &other, SetOp setOp, Aggregate aggregate, long long weight, long long otherWeight)
+{
+    // 第0层按score排列，同一data在两侧的位置无关，先各自按data排序才能同时归并
+    std::vector<std::pair<long long, void *>> array, otherArray;
+    collectNodes(array);
+    other.collectNodes(otherArray);
+
+    auto dataLess = [this](const std::pair<long long, void *> &a, const std::pair<long long, void *> &b)
+    { return m_cmpFunc(a.second, b.second) < 0; };
+    parallelSort(array, dataLess);
+    parallelSort(otherArray, dataLess);
+
+    std::vector<std::pair<long long, void *>> result;
+    result.reserve(setOp == SET_UNION ? array.size() + otherArray.size() : array.size());
+
+    size_t i = 0, j = 0;
+    while (i < array.size() && j < otherArray.size())
+    {
+        auto cmp = m_cmpFunc(array[i].second, otherArray[j].second);
+        if (cmp < 0)
+        {
+            if (setOp != SET_INTERSECT)
+            {
+                result.emplace_back(array[i].first * weight, array[i].second);
+            }
+            ++i;
+        }
+        else if (cmp > 0)
+        {
+            if (setOp == SET_UNION)
+            {
+                result.emplace_back(otherArray[j].first * otherWeight, otherArray[j].second);
+            }
+            ++j;
+        }
+        else
+        {
+            if (setOp != SET_DIFFERENCE)
+            {
+                auto score = aggregateScore(aggregate, array[i].first * weight, otherArray[j].first * otherWeight);
+                result.emplace_back(score, array[i].second);
+            }
+            ++i;
+            ++j;
+        }
+    }
+    for (; setOp != SET_INTERSECT && i < array.size(); ++i)
+    {
+        result.emplace_back(array[i].first * weight, array[i].second);
+    }
+    for (; setOp == SET_UNION && j < otherArray.size(); ++j)
+    {
+        result.emplace_back(otherArray[j].first * otherWeight, otherArray[j].second);
+    }
+
+    parallelSort(result, [this](const std::pair<long long, void *> &a, const std::pair<long long, void *> &b)
+                 { return a.first < b.first || (a.first == b.first && m_cmpFunc(a.second, b.second) < 0); });
+
+    rebuildFromSorted(result);
+}
+
+void SkipList::collectNodes(std::vector<std::pair<long long, void *>> &result) const
+{
+    result.resize(m_length);
+
+    // 每段从按排名定位的第一个节点开始沿第0层复制，各段写入result中互不重叠的部分
+    auto copyRange = [this, &result](unsigned long first, unsigned long last)
+    {
+        auto node = findByRank(first + 1);
+        for (auto i = first; i < last; ++i)
+        {
+            result[i] = {node->m_score, node->m_data};
+            node = node->m_levelArray[0].m_next;
+        }
+    };
+
+    auto threadCount = setOpThreadCount(m_length);
+    if (threadCount <= 1)
+    {
+        copyRange(0, m_length);
+        return;
+    }
+
+    std::vector<std::thread> threadArray;
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+        threadArray.emplace_back(copyRange, (unsigned long)((uint64_t)m_length * t / threadCount),
+                                 (unsigned long)((uint64_t)m_length * (t + 1) / threadCount));
+    }
+    for (auto &thread : threadArray)
+    {
+        thread.join();
+    }
+}
+
+void SkipList::rebuildFromSorted(const std::vector<std::pair<long long, void *>> &array)
+{
+    if (m_length)
+    {
+        releaseNodeList(detachRange(1, m_length), nullptr);
+    }
+
+    SkipNode *lastArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    beginAppend(lastArray, rankArray);
+
+    for (auto &entry : array)
+    {
+        auto node = createNode(genLevel());
+        node->m_score = entry.first;
+        node->m_data = entry.second;
+        appendNode(node, lastArray, rankArray);
+
+        if (m_opLog)
+        {
+            logOp(SkipListOpLog::OP_INSERT, entry.first, node->m_data);
+        }
+    }
+
+    endAppend(lastArray, rankArray);
+}
+
+void SkipList::beginAppend(SkipNode **lastArray, unsigned long *rankArray)
+{
+    auto curNode = m_head;
+    unsigned long curRank = 0;
+    for (auto i = MAX_LEVEL; i > 0; --i)
+    {
+        while (curNode->m_levelArray[i - 1].m_next)
+        {
+            curRank += curNode->m_levelArray[i - 1].m_span;
+            curNode = curNode->m_levelArray[i - 1].m_next;
+        }
+        lastArray[i - 1] = curNode;
+        rankArray[i - 1] = curRank;
+    }
+}
+
+void SkipList::appendNode(SkipNode *node, SkipNode **lastArray, unsigned long *rankArray)
+{
+    auto level = node->m_level;
+    node->m_prev = lastArray[0] == m_head ? nullptr : lastArray[0];
+
+    m_length++;
+
+    // 中间状态下各层末尾节点的跨度不正确，由endAppend补齐
+    for (auto i = 0; i < level; ++i)
+    {
+        auto &prevNodeLevel = lastArray[i]->m_levelArray[i];
+        prevNodeLevel.m_next = node;
+        prevNodeLevel.m_span = m_length - rankArray[i];
+
+        lastArray[i] = node;
+        rankArray[i] = m_length;
+    }
+
+    if (level > m_level)
+    {
+        m_level = level;
+    }
+}
+
+void SkipList::endAppend(SkipNode **lastArray, unsigned long *rankArray)
+{
+    for (auto i = 0; i < m_level; ++i)
+    {
+        lastArray[i]->m_levelArray[i].m_span = m_length - rankArray[i];
+    }
+    m_tail = lastArray[0] == m_head ? nullptr : lastArray[0];
+}
+
+std::string_view SkipList::dataBytes(void *const &data, DataToBytes dataToBytes)
+{
+    return dataToBytes ? dataToBytes(data) : std::string_view{reinterpret_cast<const char *>(&data), sizeof data};
+}
+
+void *SkipList::bytesData(std::string_view bytes, BytesToData bytesToData)
+{
+    if (bytesToData)
+    {
+        return bytesToData(bytes);
+    }
+
+    void *data = nullptr;
+    memcpy(&data, bytes.data(), bytes.size() < sizeof data ? bytes.size() : sizeof data);
+    return data;
+}
+
+void SkipList::logOp(SkipListOpLog::OpType type, long long score, void *const &data)
+{
+    m_opLog->append(type, score, dataBytes(data, m_dataToBytes));
+    if (m_opLog->needCompaction())
+    {
+        compactOpLog();
+    }
+}
+
+void SkipList::compactOpLog()
+{
+    // 在当前线程中复制全部数据，写文件留给后台线程
+    std::vector<unsigned char> records;
+    for (auto node = m_head->m_levelArray[0].m_next; node; node = node->m_levelArray[0].m_next)
+    {
+        SkipListOpLog::encodeRecord(records, SkipListOpLog::OP_INSERT, node->m_score, dataBytes(node->m_data, m_dataToBytes));
+    }
+    m_opLog->compact(std::move(records));
+}
+
+void SkipList::replayOp(void *context, SkipListOpLog::OpType type, long long score, std::string_view bytes)
+{
+    auto skipList = static_cast<SkipList *>(context);
+    auto data = bytesData(bytes, skipList->m_bytesToData);
+
+    if (type == SkipListOpLog::OP_INSERT)
+    {
+        skipList->insert(score, data);
+    }
+    else if (type == SkipListOpLog::OP_REMOVE)
+    {
+        skipList->remove(score, data);
+    }
+}
+
+void SkipList::findLastLessThan(long long score, void *data, SkipNode **updateArray, unsigned long *rankArray)
+{
+    auto curNode = m_head;
+    auto curLevel = m_level;
+    SKIPLIST_COUNT(++m_counters.m_searchCount);
+
+    rankArray[curLevel - 1] = 0;
+    while (curLevel)
+    {
+        if (curLevel < m_level)
+        {
+            rankArray[curLevel - 1] = rankArray[curLevel];
+        }
+
+        auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        while (nextNode &&
                (nextNode->m_score < score || (nextNode->m_score == score && m_cmpFunc(nextNode->m_data, data) < 0)))
         {
+            SKIPLIST_COUNT(++m_counters.m_visitArray[curLevel - 1]);
             rankArray[curLevel - 1] += curNode->m_levelArray[curLevel - 1].m_span;
             curNode = nextNode;
             nextNode = curNode->m_levelArray[curLevel - 1].m_next;
         }
+        SKIPLIST_COUNT(m_counters.m_stopCount += nextNode != nullptr);
 
         updateArray[curLevel - 1] = curNode;
 
         --curLevel;
     }
 }
+
+SkipList::SkipNode *SkipList::findByRank(unsigned long rank) const
+{
+    auto curNode = m_head;
+    auto curLevel = m_level;
+    unsigned long curRank = 0;
+
+    while (curLevel)
+    {
+        auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        while (nextNode && curRank + curNode->m_levelArray[curLevel - 1].m_span <= rank)
+        {
+            curRank += curNode->m_levelArray[curLevel - 1].m_span;
+            curNode = nextNode;
+            nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        }
+
+        if (curRank == rank)
+        {
+            return curNode;
+        }
+
+        --curLevel;
+    }
+
+    return nullptr;
+}
+
+bool SkipList::scoreFitsInPlace(SkipNode *node, long long newScore)
+{
+    auto prevNode = node->m_prev;
+    auto nextNode = node->m_levelArray[0].m_next;
+    return (!prevNode || prevNode->m_score < newScore ||
+            (prevNode->m_score == newScore && m_cmpFunc(prevNode->m_data, node->m_data) < 0)) &&
+           (!nextNode || nextNode->m_score > newScore ||
+            (nextNode->m_score == newScore && m_cmpFunc(nextNode->m_data, node->m_data) > 0));
+}
+
+void SkipList::relinkNode(SkipNode *node, long long newScore, SkipNode **updateArray, unsigned long *rankArray)
+{
+    unlinkNode(node, updateArray);
+    node->m_score = newScore;
+    findLastLessThan(newScore, node->m_data, updateArray, rankArray);
+    linkNode(node, updateArray, rankArray);
+}
+
+bool SkipList::scoreGteMin(long long score, const ScoreRange &range)
+{
+    return range.m_minExclusive ? score > range.m_min : score >= range.m_min;
+}
+
+bool SkipList::scoreLteMax(long long score, const ScoreRange &range)
+{
+    return range.m_maxExclusive ? score < range.m_max : score <= range.m_max;
+}
+
+SkipList::SkipNode *SkipList::findFirstInRange(const ScoreRange &range, unsigned long *rank)
+{
+    auto curNode = m_head;
+    auto curLevel = m_level;
+    unsigned long curRank = 0;
+
+    while (curLevel)
+    {
+        auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        while (nextNode && !scoreGteMin(nextNode->m_score, range))
+        {
+            curRank += curNode->m_levelArray[curLevel - 1].m_span;
+            curNode = nextNode;
+            nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        }
+
+        --curLevel;
+    }
+
+    auto node = curNode->m_levelArray[0].m_next;
+    if (!node || !scoreLteMax(node->m_score, range))
+    {
+        return nullptr;
+    }
+
+    *rank = curRank + 1;
+    return node;
+}
+
+SkipList::SkipNode *SkipList::findLastInRange(const ScoreRange &range, unsigned long *rank)
+{
+    auto curNode = m_head;
+    auto curLevel = m_level;
+    unsigned long curRank = 0;
+
+    while (curLevel)
+    {
+        auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        while (nextNode && scoreLteMax(nextNode->m_score, range))
+        {
+            curRank += curNode->m_levelArray[curLevel - 1].m_span;
+            curNode = nextNode;
+            nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        }
+
+        --curLevel;
+    }
+
+    if (curNode == m_head || !scoreGteMin(curNode->m_score, range))
+    {
+        return nullptr;
+    }
+
+    *rank = curRank;
+    return curNode;
+}
+
+bool SkipList::SnapshotFile::open(const char *path)
+{
+    close();
+
+    m_data = mapFile(path, &m_size);
+    if (!m_data)
+    {
+        return false;
+    }
+
+    if (!validate())
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void SkipList::SnapshotFile::close()
+{
+    if (m_data)
+    {
+        unmapFile(m_data, m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_cursor = m_end = nullptr;
+    m_count = 0;
+}
+
+bool SkipList::SnapshotFile::next(long long *score, std::string_view *member)
+{
+    if (m_cursor == m_end)
+    {
+        return false;
+    }
+
+    // 记录没有对齐，按字节拷贝读取
+    int64_t recordScore;
+    uint32_t length;
+    memcpy(&recordScore, m_cursor, sizeof recordScore);
+    memcpy(&length, m_cursor + sizeof recordScore, sizeof length);
+    m_cursor += SNAPSHOT_RECORD_HEADER_SIZE;
+
+    *score = recordScore;
+    *member = std::string_view{reinterpret_cast<const char *>(m_cursor), length};
+    m_cursor += length;
+
+    return true;
+}
+
+bool SkipList::SnapshotFile::validate()
+{
+    SnapshotHeader header;
+    if (m_size < sizeof header)
+    {
+        return false;
+    }
+    memcpy(&header, m_data, sizeof header);
+
+    // 字节序不同时版本号也对不上
+    if (memcmp(header.m_magic, SNAPSHOT_MAGIC, sizeof header.m_magic) != 0 ||
+        header.m_version != SNAPSHOT_VERSION || header.m_payloadSize != m_size - sizeof header)
+    {
+        return false;
+    }
+
+    auto payload = m_data + sizeof header;
+    if (skipListChecksum(header.m_count, payload, header.m_payloadSize) != header.m_checksum)
+    {
+        return false;
+    }
+
+    // 检查记录边界和score顺序，之后逐条读取和链接时不会再失败
+    auto cursor = payload;
+    auto end = m_data + m_size;
+    uint64_t count = 0;
+    int64_t lastScore = LLONG_MIN;
+    while (cursor != end)
+    {
+        if ((size_t)(end - cursor) < SNAPSHOT_RECORD_HEADER_SIZE)
+        {
+            return false;
+        }
+
+        int64_t score;
+        uint32_t length;
+        memcpy(&score, cursor, sizeof score);
+        memcpy(&length, cursor + sizeof score, sizeof length);
+        cursor += SNAPSHOT_RECORD_HEADER_SIZE;
+
+        if ((size_t)(end - cursor) < length || score < lastScore)
+        {
+            return false;
+        }
+
+        cursor += length;
+        lastScore = score;
+        ++count;
+    }
+
+    if (count != header.m_count)
+    {
+        return false;
+    }
+
+    m_cursor = payload;
+    m_end = end;
+    m_count = count;
+
+    return true;
+}
@@ -1,6 +1,14 @@
 #pragma once
 
+#include <cstdint>
 #include <cstdlib>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "SkipListLevelGen.h"
+#include "SkipListOpLog.h"
+#include "SkipListStats.h"
 
 class SkipList
 {
@@ -19,38 +27,210 @@ protected:
     {
         long long m_score = 0;
         void *m_data = nullptr;
-        SkipLevel *m_levelArray = nullptr;
         SkipNode *m_prev = nullptr;
+        // 节点层高
+        unsigned char m_level = 0;
+        // 层数组，与节点一次分配，实际长度为节点层高
+        SkipLevel m_levelArray[1];
     };
 
 public:
+    // score区间[m_min, m_max]，m_minExclusive/m_maxExclusive为true时不包含对应端点
+    struct ScoreRange
+    {
+        long long m_min = 0;
+        long long m_max = 0;
+        bool m_minExclusive = false;
+        bool m_maxExclusive = false;
+    };
+
+    // 集合运算中同一data两侧score的合并方式
+    enum class Aggregate
+    {
+        SUM,
+        MIN,
+        MAX,
+    };
+
+    // 快照中data的序列化函数，返回data对应的字节，为nullptr时直接保存指针的值
+    using DataToBytes = std::string_view (*)(const void *data);
+    // 由快照中的字节重建data，bytes指向映射的文件内存，返回后不再有效，为nullptr时直接恢复指针的值
+    using BytesToData = void *(*)(std::string_view bytes);
+
     SkipList(CmpFunc cmpFunc = [](void *a, void *b) -> int
              { return a < b ? -1 : a == b ? 0
-                                          : 1; });
-    ~SkipList();
+                                          : 1; },
+             uint64_t levelSeed = 0);
+    virtual ~SkipList();
 
     bool insert(long long score, void *data);
     bool remove(long long score, void *data);
+    // 将{oldScore, data}的score改为newScore，顺序不变时原地修改，否则复用节点重新链接
+    bool updateScore(long long oldScore, void *data, long long newScore);
+
+    // 获取{score, data}的排名(从0开始)，不存在时返回-1
+    long getRank(long long score, void *data);
+    // 获取排名为rank的节点，rank为负数时从尾部倒数，越界时返回false
+    bool getByRank(long rank, long long *score, void **data);
+    // 获取排名在[start, stop]内的节点，start/stop为负数时从尾部倒数
+    void rangeByRank(long start, long stop, std::vector<std::pair<long long, void *>> &result);
+
+    // 按score从小到大获取区间内的节点，跳过前offset个，最多取limit个，limit为负数时不限个数
+    void rangeByScore(const ScoreRange &range, std::vector<std::pair<long long, void *>> &result,
+                      unsigned long offset = 0, long limit = -1);
+    // 按score从大到小获取区间内的节点，跳过前offset个，最多取limit个，limit为负数时不限个数
+    void revRangeByScore(const ScoreRange &range, std::vector<std::pair<long long, void *>> &result,
+                         unsigned long offset = 0, long limit = -1);
+    // 区间内的节点个数，只需两次查找
+    unsigned long count(const ScoreRange &range);
+
+    // 删除排名在[start, stop]内的节点，start/stop为负数时从尾部倒数，返回删除的个数；
+    // removed不为nullptr时按顺序追加被删除的{score, data}
+    unsigned long removeRangeByRank(long start, long stop, std::vector<std::pair<long long, void *>> *removed = nullptr);
+    // 删除score在区间内的节点，返回删除的个数
+    unsigned long removeRangeByScore(const ScoreRange &range, std::vector<std::pair<long long, void *>> *removed = nullptr);
+    // 弹出score最小/最大的count个节点，整段摘除而不逐个查找，返回弹出的个数；
+    // result先清空再按弹出顺序(popMax为从大到小)写入{score, data}，反复传入同一个缓冲区可以复用其容量
+    unsigned long popMin(unsigned long count, std::vector<std::pair<long long, void *>> &result);
+    unsigned long popMax(unsigned long count, std::vector<std::pair<long long, void *>> &result);
+
+    // 集合运算：按data(m_cmpFunc相等)匹配两个跳表的节点，用结果替换当前跳表的内容，要求每个跳表中同一data只出现一次。
+    // 两侧的score先分别乘以weight/otherWeight，两侧都有的data按aggregate合并。
+    // 两个跳表先按data排序后同时归并，结果按{score, data}排序后顺序追加一次建成，不做逐个插入的查找；
+    // 节点多时按排名分段并行复制和排序
+    void unionWith(const SkipList &other, Aggregate aggregate = Aggregate::SUM, long long weight = 1, long long otherWeight = 1);
+    void intersectWith(const SkipList &other, Aggregate aggregate = Aggregate::SUM, long long weight = 1, long long otherWeight = 1);
+    // 只保留other中没有的data，score乘以weight
+    void differenceWith(const SkipList &other, long long weight = 1);
+
+    // 按顺序将{score, data}写入快照文件，先写path.tmp再替换path
+    bool saveSnapshot(const char *path, DataToBytes dataToBytes = nullptr) const;
+    // 从快照文件恢复，要求跳表为空，且m_cmpFunc对重建的data的顺序与保存时一致；
+    // 文件映射到内存并整体校验后按顺序直接链接各层，不做逐条查找
+    bool loadSnapshot(const char *path, BytesToData bytesToData = nullptr);
+
+    // 挂接操作日志：打开opLog并重放其中的操作，之后成功的修改都追加到日志，日志段过大时自动压缩；
+    // opLog为nullptr时取消挂接，不关闭日志。dataToBytes/bytesToData与快照相同，
+    // 重放删除时用bytesToData重建的data按m_cmpFunc匹配节点
+    bool attachOpLog(SkipListOpLog *opLog, DataToBytes dataToBytes = nullptr, BytesToData bytesToData = nullptr);
+
+    // 统计信息：层高分布和内存占用每次遍历全部节点计算，不含派生类在节点尾部额外分配的字节；
+    // 查找计数器只在定义SKIPLIST_STATS时统计
+    SkipListStats stats() const;
+    // 清零查找计数器
+    void resetStats();
 
 protected:
+    // 映射到内存的快照文件，open时校验文件头、校验和与记录边界，析构时解除映射
+    class SnapshotFile
+    {
+    public:
+        SnapshotFile() = default;
+        ~SnapshotFile() { close(); }
+
+        SnapshotFile(const SnapshotFile &) = delete;
+        SnapshotFile &operator=(const SnapshotFile &) = delete;
+
+        bool open(const char *path);
+        void close();
+
+        // 记录条数
+        uint64_t count() const { return m_count; }
+        // 按顺序读取下一条记录，member指向映射的文件内存，读完时返回false
+        bool next(long long *score, std::string_view *member);
+
+    protected:
+        bool validate();
+
+        const unsigned char *m_data = nullptr;
+        size_t m_size = 0;
+        const unsigned char *m_cursor = nullptr;
+        const unsigned char *m_end = nullptr;
+        uint64_t m_count = 0;
+    };
+
     // 层高上限
     const static unsigned char MAX_LEVEL = 32;
-    // 增加1层的概率参数
-    const static int LEVEL_THRESHOLD = 0.25 * RAND_MAX;
+
+    // 集合运算的类型
+    enum SetOp
+    {
+        SET_UNION,
+        SET_INTERSECT,
+        SET_DIFFERENCE,
+    };
 
     // 生成节点层高
     unsigned char genLevel();
 
-    // 创建有level层的节点
-    SkipNode *createNode(unsigned char level);
+    // 有level层的节点占用的内存大小
+    static size_t nodeSize(unsigned char level) { return sizeof(SkipNode) + (level - 1) * sizeof(SkipLevel); }
+    // 创建有level层的节点，extraSize为在节点尾部额外分配的字节数，供派生类存放数据
+    SkipNode *createNode(unsigned char level, size_t extraSize = 0);
     // 释放节点
     void releaseNode(SkipNode *node);
 
+    // 将新节点链接到updateArray记录的各层前驱之后
+    void linkNode(SkipNode *newNode, SkipNode **updateArray, unsigned long *rankArray);
+    // 将节点从各层摘除，updateArray为各层前驱，不释放节点
+    void unlinkNode(SkipNode *node, SkipNode **updateArray);
+
+    // 一次查找同时定位排名[firstRank, lastRank](从1开始)两端的各层前驱，整段摘除并一次性修正跨度，
+    // 返回摘除的节点链，沿第0层的m_next相连并以nullptr结尾，不释放节点
+    SkipNode *detachRange(unsigned long firstRank, unsigned long lastRank);
+    // 释放detachRange返回的节点链，removed不为nullptr时按顺序追加{score, data}；
+    // removeRangeByRank/removeRangeByScore/popMin/popMax和集合运算都经由此函数释放节点，
+    // 派生类可以重写，在释放前清理自己的索引，或把节点交给内存池
+    virtual void releaseNodeList(SkipNode *node, std::vector<std::pair<long long, void *>> *removed);
+
+    // 按顺序追加节点：lastArray/rankArray为每层当前的最后一个节点及其排名，
+    // beginAppend定位现有的各层末尾，appendNode直接链接到末尾，endAppend补齐末尾跨度和m_tail
+    void beginAppend(SkipNode **lastArray, unsigned long *rankArray);
+    void appendNode(SkipNode *node, SkipNode **lastArray, unsigned long *rankArray);
+    void endAppend(SkipNode **lastArray, unsigned long *rankArray);
+
+    // 集合运算的实现
+    void combineWith(const SkipList &other, SetOp setOp, Aggregate aggregate, long long weight, long long otherWeight);
+    // 按顺序复制全部节点的{score, data}，节点多时按排名分段由多个线程并行复制
+    void collectNodes(std::vector<std::pair<long long, void *>> &result) const;
+    // 删除全部节点，再用有序的{score, data}顺序追加重建
+    void rebuildFromSorted(const std::vector<std::pair<long long, void *>> &array);
+
+    // data在快照和操作日志中的字节，以及由字节重建data
+    static std::string_view dataBytes(void *const &data, DataToBytes dataToBytes);
+    static void *bytesData(std::string_view bytes, BytesToData bytesToData);
+    // 将对{score, data}的操作追加到操作日志，日志段过大时开始压缩
+    void logOp(SkipListOpLog::OpType type, long long score, void *const &data);
+    // 将当前全部数据作为插入记录交给操作日志在后台压缩
+    void compactOpLog();
+    // 重放操作日志中的一条记录，context为SkipList
+    static void replayOp(void *context, SkipListOpLog::OpType type, long long score, std::string_view bytes);
+
     // 找到最后一个小于{score, data}的节点，
     void findLastLessThan(long long score, void *data, SkipNode **updateArray, unsigned long *rankArray);
+    // 找到排名为rank(从1开始)的节点
+    SkipNode *findByRank(unsigned long rank) const;
+
+    // score是否不小于/不大于区间的下界/上界
+    static bool scoreGteMin(long long score, const ScoreRange &range);
+    static bool scoreLteMax(long long score, const ScoreRange &range);
+    // 找到区间内的第一个/最后一个节点及其排名(从1开始)，区间内没有节点时返回nullptr
+    SkipNode *findFirstInRange(const ScoreRange &range, unsigned long *rank);
+    SkipNode *findLastInRange(const ScoreRange &range, unsigned long *rank);
+    // 节点的score改为newScore后是否仍然位于前后节点之间，是则可以原地修改
+    bool scoreFitsInPlace(SkipNode *node, long long newScore);
+    // 摘除节点后按newScore重新链接，节点和层数组都复用，updateArray为节点当前的各层前驱
+    void relinkNode(SkipNode *node, long long newScore, SkipNode **updateArray, unsigned long *rankArray);
 
     // 用户数据比较函数指针
     CmpFunc m_cmpFunc;
+    // 层高生成器，levelSeed为0时使用线程局部的随机数发生器
+    SkipListLevelGen<MAX_LEVEL> m_levelGen;
+
+    // 挂接的操作日志，为nullptr时不记录
+    SkipListOpLog *m_opLog = nullptr;
+    DataToBytes m_dataToBytes = nullptr;
+    BytesToData m_bytesToData = nullptr;
 
     SkipNode *m_head = nullptr;
     SkipNode *m_tail = nullptr;
@@ -59,4 +239,9 @@ protected:
     unsigned char m_level = 0;
     // 节点总数
     unsigned long m_length = 0;
+
+#ifdef SKIPLIST_STATS
+    // 查找计数器
+    SkipListCounters<MAX_LEVEL> m_counters;
+#endif
 };
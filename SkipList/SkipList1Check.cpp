@@ -0,0 +1,258 @@
+// SkipList1与std::map/std::set模型对照的测试，覆盖集合运算和popMin/popMax：
+//   g++ -std=c++17 -O2 SkipList1Check.cpp SkipList1.cpp SkipListOpLog.cpp -pthread -o skiplist1_check
+// 集合运算只在节点很多时才并行，要在小数据上覆盖并行的排序、归并和复制，编译SkipList1.cpp时改小粒度并指定线程数：
+//   g++ -std=c++17 -O2 -DSKIPLIST_SET_OP_PARALLEL_GRAIN=8 -DSKIPLIST_SET_OP_THREADS=4 SkipList1Check.cpp SkipList1.cpp SkipListOpLog.cpp -pthread -o skiplist1_check
+// 全部检查通过时返回0。
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+#include "SkipList1.h"
+
+using Entry = std::pair<long long, void *>;
+
+// xorshift64，生成测试用的data和score
+static uint64_t nextRandom(uint64_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// 测试用的data直接用整数充当指针，默认比较函数按指针值比较
+static void *toData(long key)
+{
+    return reinterpret_cast<void *>((uintptr_t)key);
+}
+
+// 全部内容与按{score, data}排序的期望结果逐项对照，并抽查排名
+static bool compareAll(SkipList &skipList, const std::vector<Entry> &expected)
+{
+    std::vector<Entry> result;
+    skipList.rangeByRank(0, -1, result);
+    if (result != expected)
+    {
+        printf("content mismatch, size %zu, expected %zu\n", result.size(), expected.size());
+        return false;
+    }
+    for (size_t i = 0; i < result.size(); i += 1 + result.size() / 64)
+    {
+        if (skipList.getRank(result[i].first, result[i].second) != (long)i)
+        {
+            printf("rank mismatch at %zu\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// 集合运算的模型：data到score的map，按data归并后再按{score, data}排序
+static std::vector<Entry> expectSetOp(const std::map<long, long long> &a, const std::map<long, long long> &b, int setOp,
+                                      SkipList::Aggregate aggregate, long long weight, long long otherWeight)
+{
+    std::vector<Entry> result;
+    for (auto &item : a)
+    {
+        auto it = b.find(item.first);
+        if (it == b.end())
+        {
+            if (setOp != 1)
+            {
+                result.emplace_back(item.second * weight, toData(item.first));
+            }
+            continue;
+        }
+        if (setOp == 2)
+        {
+            continue;
+        }
+
+        auto score = item.second * weight, otherScore = it->second * otherWeight;
+        switch (aggregate)
+        {
+        case SkipList::Aggregate::MIN:
+            score = std::min(score, otherScore);
+            break;
+        case SkipList::Aggregate::MAX:
+            score = std::max(score, otherScore);
+            break;
+        default:
+            score += otherScore;
+            break;
+        }
+        result.emplace_back(score, toData(item.first));
+    }
+    if (setOp == 0)
+    {
+        for (auto &item : b)
+        {
+            if (!a.count(item.first))
+            {
+                result.emplace_back(item.second * otherWeight, toData(item.first));
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+// 随机生成count个不重复data，同时写入跳表和模型
+static void fillRandom(SkipList &skipList, std::map<long, long long> &model, int count, uint64_t &state)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        auto random = nextRandom(state);
+        long key = (long)(random % (count * 2 + 1)) + 1;
+        long long score = (long long)(random / 65536 % 100) - 50;
+        if (model.emplace(key, score).second)
+        {
+            skipList.insert(score, toData(key));
+        }
+    }
+}
+
+// unionWith/intersectWith/differenceWith轮流执行，覆盖各种聚合方式和权重(含0和负数)，
+// 最后几轮节点数超过默认的并行粒度
+static bool verifySetOps(int roundCount, uint64_t seed)
+{
+    uint64_t state = seed;
+    for (int round = 0; round < roundCount; ++round)
+    {
+        int count = round + 3 < roundCount ? (int)(nextRandom(state) % 300) : 200000;
+        SkipList skipList, other;
+        std::map<long, long long> model, otherModel;
+        fillRandom(skipList, model, count, state);
+        fillRandom(other, otherModel, count, state);
+
+        auto setOp = round % 3;
+        auto aggregate = (SkipList::Aggregate)(nextRandom(state) % 3);
+        long long weight = (long long)(nextRandom(state) % 5) - 2;
+        long long otherWeight = (long long)(nextRandom(state) % 5) - 2;
+        if (setOp == 0)
+        {
+            skipList.unionWith(other, aggregate, weight, otherWeight);
+        }
+        else if (setOp == 1)
+        {
+            skipList.intersectWith(other, aggregate, weight, otherWeight);
+        }
+        else
+        {
+            skipList.differenceWith(other, weight);
+        }
+
+        if (!compareAll(skipList, expectSetOp(model, otherModel, setOp, aggregate, weight, otherWeight)))
+        {
+            printf("set op %d failed in round %d, count %d\n", setOp, round, count);
+            return false;
+        }
+    }
+
+    // 与自身运算：两侧是同一个跳表
+    SkipList skipList;
+    std::vector<Entry> expected;
+    for (long i = 1; i <= 100; ++i)
+    {
+        skipList.insert(i, toData(i));
+        expected.emplace_back(2 * i, toData(i));
+    }
+    skipList.unionWith(skipList);
+    if (!compareAll(skipList, expected))
+    {
+        printf("self union failed\n");
+        return false;
+    }
+    skipList.differenceWith(skipList);
+    return compareAll(skipList, {});
+}
+
+// 随机插入与popMin/popMax交替，弹出的内容和顺序与std::set两端一致；count为0或超过长度时按实际个数弹出
+static bool verifyPop(int opCount, uint64_t seed)
+{
+    SkipList skipList;
+    std::set<Entry> model;
+    std::vector<Entry> result;
+
+    uint64_t state = seed;
+    for (int i = 0; i < opCount; ++i)
+    {
+        auto random = nextRandom(state);
+        auto count = (unsigned long)(random / 1024 % 9);
+        bool ok = true;
+        switch (random / 65536 % 10)
+        {
+        case 0:
+        case 1:
+        case 2:
+        case 3:
+        case 4:
+        case 5:
+        {
+            long long score = (long long)(random / 1048576 % 1000);
+            auto data = toData((long)(random % 100000) + 1);
+            if (skipList.insert(score, data) != model.emplace(score, data).second)
+            {
+                ok = false;
+            }
+            break;
+        }
+        case 6:
+        case 7:
+            ok = skipList.popMin(count, result) == std::min<size_t>(count, model.size()) && result.size() == std::min<size_t>(count, model.size());
+            for (size_t j = 0; ok && j < result.size(); ++j)
+            {
+                ok = result[j] == *model.begin();
+                model.erase(model.begin());
+            }
+            break;
+        default:
+            // popMax按从大到小的顺序返回
+            ok = skipList.popMax(count, result) == std::min<size_t>(count, model.size()) && result.size() == std::min<size_t>(count, model.size());
+            for (size_t j = 0; ok && j < result.size(); ++j)
+            {
+                ok = result[j] == *model.rbegin();
+                model.erase(std::prev(model.end()));
+            }
+            break;
+        }
+
+        if (!ok)
+        {
+            printf("pop mismatch at op %d\n", i);
+            return false;
+        }
+        if (i % 499 == 0 && !compareAll(skipList, std::vector<Entry>(model.begin(), model.end())))
+        {
+            printf("at op %d\n", i);
+            return false;
+        }
+    }
+
+    // 全部弹出后为空，再弹出返回0
+    auto size = model.size();
+    if (skipList.popMax(size + 5, result) != size || skipList.popMin(1, result) != 0 || !result.empty())
+    {
+        printf("pop all failed\n");
+        return false;
+    }
+    return compareAll(skipList, {});
+}
+
+int main()
+{
+    printf("begin\n");
+
+    bool ok = true;
+    ok = verifySetOps(300, 0x9e3779b97f4a7c15ull) && ok;
+    ok = verifyPop(200000, 0x2545f4914f6cdd1dull) && ok;
+
+    printf("%s\n", ok ? "ok" : "FAILED");
+    printf("end\n");
+
+    return ok ? 0 : 1;
+}
@@ -1,7 +1,7 @@
 #include "SkipList2.h"
 
-SkipList::SkipList(CmpFunc cmpFunc)
-    : m_cmpFunc{cmpFunc}
+SkipList::SkipList(CmpFunc cmpFunc, uint64_t levelSeed, PrefixFunc prefixFunc)
+    : m_cmpFunc{cmpFunc}, m_prefixFunc{prefixFunc}, m_levelGen{levelSeed}
 {
     m_head = createNode(MAX_LEVEL);
     m_level = 1;
@@ -22,9 +22,10 @@ const void *SkipList::find(const void *data)
     SkipNode *updateArray[MAX_LEVEL];
     unsigned long rankArray[MAX_LEVEL];
 
-    findLastLessThan(data, updateArray, rankArray);
+    auto prefix = getPrefix(data);
+    findLastLessThan(data, prefix, updateArray, rankArray);
     auto nextNode = updateArray[0]->m_levelArray[0].m_next;
-    if (nextNode && m_cmpFunc(nextNode->m_data, data) == 0)
+    if (nextNode && compareNode(nextNode, data, prefix) == 0)
     {
         return nextNode->m_data;
     }
@@ -37,15 +38,17 @@ bool SkipList::insert(const void *data)
     SkipNode *updateArray[MAX_LEVEL];
     unsigned long rankArray[MAX_LEVEL];
 
-    findLastLessThan(data, updateArray, rankArray);
+    auto prefix = getPrefix(data);
+    findLastLessThan(data, prefix, updateArray, rankArray);
     auto nextNode = updateArray[0]->m_levelArray[0].m_next;
-    if (nextNode && m_cmpFunc(nextNode->m_data, data) == 0)
+    if (nextNode && compareNode(nextNode, data, prefix) == 0)
     {
         return false;
     }
 
     auto level = genLevel();
     auto newNode = createNode(level);
+    newNode->m_prefix = prefix;
     newNode->m_data = data;
 
     if (level > m_level)
@@ -98,10 +101,11 @@ bool SkipList::remove(const void *data)
     SkipNode *updateArray[MAX_LEVEL];
     unsigned long rankArray[MAX_LEVEL];
 
-    findLastLessThan(data, updateArray, rankArray);
+    auto prefix = getPrefix(data);
+    findLastLessThan(data, prefix, updateArray, rankArray);
 
     auto nextNode = updateArray[0]->m_levelArray[0].m_next;
-    if (!nextNode || m_cmpFunc(nextNode->m_data, data) != 0)
+    if (!nextNode || compareNode(nextNode, data, prefix) != 0)
     {
         return false;
     }
@@ -141,18 +145,103 @@ bool SkipList::remove(const void *data)
     return true;
 }
 
+long SkipList::getRank(const void *data)
+{
+    SkipNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+
+    auto prefix = getPrefix(data);
+    findLastLessThan(data, prefix, updateArray, rankArray);
+
+    auto nextNode = updateArray[0]->m_levelArray[0].m_next;
+    if (!nextNode || compareNode(nextNode, data, prefix) != 0)
+    {
+        return -1;
+    }
+
+    return rankArray[0];
+}
+
+const void *SkipList::getByRank(long rank)
+{
+    if (rank < 0)
+    {
+        rank += m_length;
+    }
+    if (rank < 0 || rank >= (long)m_length)
+    {
+        return nullptr;
+    }
+
+    return findByRank(rank + 1)->m_data;
+}
+
+void SkipList::rangeByRank(long start, long stop, std::vector<const void *> &result)
+{
+    result.clear();
+
+    if (start < 0)
+    {
+        start += m_length;
+    }
+    if (stop < 0)
+    {
+        stop += m_length;
+    }
+    if (start < 0)
+    {
+        start = 0;
+    }
+    if (stop >= (long)m_length)
+    {
+        stop = m_length - 1;
+    }
+    if (start > stop)
+    {
+        return;
+    }
+
+    result.reserve(stop - start + 1);
+    auto node = findByRank(start + 1);
+    for (auto i = start; i <= stop; ++i)
+    {
+        result.push_back(node->m_data);
+        node = node->m_levelArray[0].m_next;
+    }
+}
+
+SkipListStats SkipList::stats() const
+{
+    SkipListStats stats;
+#ifdef SKIPLIST_STATS
+    stats.setCounters(m_counters);
+#endif
+    stats.m_length = m_length;
+    stats.countNodes(m_head, m_level, nodeSize);
+    stats.m_totalBytes = sizeof(*this) + nodeSize(MAX_LEVEL) + stats.m_nodeBytes;
+    return stats;
+}
+
+void SkipList::resetStats()
+{
+#ifdef SKIPLIST_STATS
+    m_counters = {};
+#endif
+}
+
 unsigned char SkipList::genLevel()
 {
-    unsigned char level = 1;
-    while (level < MAX_LEVEL && rand() <= LEVEL_THRESHOLD)
-        ++level;
-    return level;
+    return m_levelGen();
 }
 
 SkipList::SkipNode *SkipList::createNode(unsigned char level)
 {
-    auto node = new SkipNode;
-    node->m_levelArray = new SkipLevel[level];
+    auto memory = ::operator new(nodeSize(level));
+    auto node = new (memory) SkipNode;
+    for (auto i = 1; i < level; ++i)
+    {
+        new (&node->m_levelArray[i]) SkipLevel;
+    }
     return node;
 }
 
@@ -160,14 +249,40 @@ void SkipList::releaseNode(SkipNode *node)
 {
     if (!node)
         return;
-    delete[] node->m_levelArray;
-    delete node;
+    node->~SkipNode();
+    ::operator delete(node);
+}
+
+uint64_t SkipList::cstringPrefix(const void *data)
+{
+    auto str = static_cast<const unsigned char *>(data);
+    uint64_t prefix = 0;
+    for (auto i = 0; i < 8; ++i)
+    {
+        prefix <<= 8;
+        if (*str)
+        {
+            prefix |= *str++;
+        }
+    }
+    return prefix;
+}
+
+int SkipList::compareNode(const SkipNode *node, const void *data, uint64_t prefix) const
+{
+    if (node->m_prefix != prefix)
+    {
+        return node->m_prefix < prefix ? -1 : 1;
+    }
+
+    return m_cmpFunc(node->m_data, data);
 }
 
-SkipList::SkipNode *SkipList::findLastLessThan(const void *data, SkipNode **updateArray, unsigned long *rankArray)
+SkipList::SkipNode *SkipList::findLastLessThan(const void *data, uint64_t prefix, SkipNode **updateArray, unsigned long *rankArray)
 {
     auto curNode = m_head;
     auto curLevel = m_level;
+    SKIPLIST_COUNT(++m_counters.m_searchCount);
 
     rankArray[curLevel - 1] = 0;
     while (curLevel)
@@ -179,12 +294,14 @@ SkipList::SkipNode *SkipList::findLastLessThan(const void *data, SkipNode **upda
 
         auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
         while (nextNode &&
-               m_cmpFunc(nextNode->m_data, data) < 0)
+               compareNode(nextNode, data, prefix) < 0)
         {
+            SKIPLIST_COUNT(++m_counters.m_visitArray[curLevel - 1]);
             rankArray[curLevel - 1] += curNode->m_levelArray[curLevel - 1].m_span;
             curNode = nextNode;
             nextNode = curNode->m_levelArray[curLevel - 1].m_next;
         }
+        SKIPLIST_COUNT(m_counters.m_stopCount += nextNode != nullptr);
 
         updateArray[curLevel - 1] = curNode;
 
@@ -193,3 +310,30 @@ SkipList::SkipNode *SkipList::findLastLessThan(const void *data, SkipNode **upda
 
     return curNode;
 }
+
+SkipList::SkipNode *SkipList::findByRank(unsigned long rank)
+{
+    auto curNode = m_head;
+    auto curLevel = m_level;
+    unsigned long curRank = 0;
+
+    while (curLevel)
+    {
+        auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        while (nextNode && curRank + curNode->m_levelArray[curLevel - 1].m_span <= rank)
+        {
+            curRank += curNode->m_levelArray[curLevel - 1].m_span;
+            curNode = nextNode;
+            nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        }
+
+        if (curRank == rank)
+        {
+            return curNode;
+        }
+
+        --curLevel;
+    }
+
+    return nullptr;
+}
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <cstdint>
 #include <cstdlib>
+#include <new>
+#include <vector>
+#include "SkipListLevelGen.h"
+#include "SkipListStats.h"
 
 class SkipList
 {
 protected:
     using CmpFunc = int (*)(const void *, const void *);
+    // 键前缀提取函数：把数据映射为保序的64位整数，前缀不同时其大小关系必须与m_cmpFunc一致
+    using PrefixFunc = uint64_t (*)(const void *);
 
     struct SkipNode;
 
@@ -17,40 +24,70 @@ protected:
 
     struct SkipNode
     {
+        // 数据的键前缀，未设置前缀提取函数时为0
+        uint64_t m_prefix = 0;
         const void *m_data = nullptr;
-        SkipLevel *m_levelArray = nullptr;
         SkipNode *m_prev = nullptr;
+        // 层数组，与节点一次分配，实际长度为节点层高
+        SkipLevel m_levelArray[1];
     };
 
 public:
     SkipList(CmpFunc cmpFunc = [](const void *a, const void *b) -> int
              { return a < b ? -1 : a == b ? 0
-                                          : 1; });
+                                          : 1; },
+             uint64_t levelSeed = 0, PrefixFunc prefixFunc = nullptr);
     ~SkipList();
 
+    // 以NUL结尾的字符串的键前缀：前8个字节按大端拼成整数，与strcmp的顺序一致
+    static uint64_t cstringPrefix(const void *data);
+
     const void *find(const void *data);
     bool insert(const void *data);
     bool remove(const void *data);
 
+    // 获取data的排名(从0开始)，不存在时返回-1
+    long getRank(const void *data);
+    // 获取排名为rank的数据，rank为负数时从尾部倒数，越界时返回nullptr
+    const void *getByRank(long rank);
+    // 获取排名在[start, stop]内的数据，start/stop为负数时从尾部倒数
+    void rangeByRank(long start, long stop, std::vector<const void *> &result);
+
+    // 统计信息：层高分布和内存占用每次遍历全部节点计算，查找计数器只在定义SKIPLIST_STATS时统计
+    SkipListStats stats() const;
+    // 清零查找计数器
+    void resetStats();
+
 protected:
     // 层高上限
     const static unsigned char MAX_LEVEL = 32;
-    // 增加1层的概率参数
-    const static int LEVEL_THRESHOLD = 0.25 * RAND_MAX;
 
     // 生成节点层高
     unsigned char genLevel();
 
+    // 有level层的节点占用的内存大小
+    static size_t nodeSize(unsigned char level) { return sizeof(SkipNode) + (level - 1) * sizeof(SkipLevel); }
     // 创建有level层的节点
     SkipNode *createNode(unsigned char level);
     // 释放节点
     void releaseNode(SkipNode *node);
 
-    // 找到最后一个小于data的节点，并返回updateArray和rankArray
-    SkipNode *findLastLessThan(const void *data, SkipNode **updateArray, unsigned long *rankArray);
+    // 数据的键前缀
+    uint64_t getPrefix(const void *data) const { return m_prefixFunc ? m_prefixFunc(data) : 0; }
+    // 比较节点数据与data，prefix为data的键前缀：先比较前缀，相同时才调用m_cmpFunc
+    int compareNode(const SkipNode *node, const void *data, uint64_t prefix) const;
+
+    // 找到最后一个小于data的节点，并返回updateArray和rankArray，prefix为data的键前缀
+    SkipNode *findLastLessThan(const void *data, uint64_t prefix, SkipNode **updateArray, unsigned long *rankArray);
+    // 找到排名为rank(从1开始)的节点
+    SkipNode *findByRank(unsigned long rank);
 
     // 用户数据比较函数指针
     CmpFunc m_cmpFunc;
+    // 键前缀提取函数，为nullptr时每次都调用m_cmpFunc
+    PrefixFunc m_prefixFunc;
+    // 层高生成器，levelSeed为0时使用线程局部的随机数发生器
+    SkipListLevelGen<MAX_LEVEL> m_levelGen;
 
     SkipNode *m_head = nullptr;
     SkipNode *m_tail = nullptr;
@@ -59,4 +96,9 @@ protected:
     unsigned char m_level = 0;
     // 节点总数
     unsigned long m_length = 0;
+
+#ifdef SKIPLIST_STATS
+    // 查找计数器
+    SkipListCounters<MAX_LEVEL> m_counters;
+#endif
 };
@@ -0,0 +1,245 @@
+// SkipList2键前缀比较的测试，以字符串为数据，与逐个strcmp的线性扫描对照：
+//   g++ -std=c++17 -O2 SkipList2Check.cpp SkipList2.cpp -o skiplist2_check
+// 键覆盖不足8字节、前8字节相同只在后面不同，以及含大于0x7f的字节；
+// 随机插入删除后对照find/getRank/getByRank，并逐个删除前缀相同的一组节点。
+// 全部检查通过时返回0。
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "SkipList2.h"
+
+// xorshift64，生成测试用的键和操作
+static uint64_t nextRandom(uint64_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+static int compareString(const void *a, const void *b)
+{
+    return strcmp(static_cast<const char *>(a), static_cast<const char *>(b));
+}
+
+// 测试用的键，前缀相同的键集中在少数几组里
+static std::vector<std::string> makeKeys(uint64_t &state)
+{
+    static const char ALPHABET[] = {'a', 'b', 'z', '\x7f', '\x80', '\xe4'};
+    std::vector<std::string> keyArray;
+    for (int i = 0; i < 800; ++i)
+    {
+        auto random = nextRandom(state);
+        std::string key;
+        switch (i % 4)
+        {
+        case 0:
+            // 前8字节完全相同，只靠m_cmpFunc区分
+            key = "sharedpx" + std::to_string(random % 200);
+            break;
+        case 1:
+            // 第8字节不同
+            key = std::string{"sharedp"} + ALPHABET[random % sizeof ALPHABET] + std::to_string(random / 8 % 20);
+            break;
+        default:
+            // 长度1~12的随机串，短于8字节时前缀末尾补0
+            key.resize(1 + random % 12);
+            for (auto &c : key)
+            {
+                c = ALPHABET[nextRandom(state) % sizeof ALPHABET];
+            }
+            break;
+        }
+        keyArray.push_back(key);
+    }
+    return keyArray;
+}
+
+// 模型：已插入的键，查找和排名都逐个strcmp
+struct Model
+{
+    std::vector<const std::string *> m_keyArray;
+
+    long find(const std::string &key) const
+    {
+        for (size_t i = 0; i < m_keyArray.size(); ++i)
+        {
+            if (*m_keyArray[i] == key)
+            {
+                return (long)i;
+            }
+        }
+        return -1;
+    }
+
+    long countLess(const std::string &key) const
+    {
+        long count = 0;
+        for (auto item : m_keyArray)
+        {
+            count += strcmp(item->c_str(), key.c_str()) < 0;
+        }
+        return count;
+    }
+};
+
+// 用与存储的指针不同的副本查找，结果与线性扫描一致
+static bool compareLookup(SkipList &skipList, const Model &model, const std::string &key)
+{
+    std::string copy = key;
+    auto index = model.find(copy);
+    auto data = static_cast<const char *>(skipList.find(copy.c_str()));
+    if (index < 0 ? data != nullptr : data != model.m_keyArray[index]->c_str())
+    {
+        printf("find mismatch for \"%s\"\n", key.c_str());
+        return false;
+    }
+    if (skipList.getRank(copy.c_str()) != (index < 0 ? -1 : model.countLess(copy)))
+    {
+        printf("getRank mismatch for \"%s\"\n", key.c_str());
+        return false;
+    }
+    return true;
+}
+
+// 全部内容按排名逐项对照：排名为i的数据之前恰好有i个更小的键
+static bool compareAll(SkipList &skipList, const Model &model)
+{
+    std::vector<const void *> result;
+    skipList.rangeByRank(0, -1, result);
+    if (result.size() != model.m_keyArray.size())
+    {
+        printf("size mismatch %zu != %zu\n", result.size(), model.m_keyArray.size());
+        return false;
+    }
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+        std::string key = static_cast<const char *>(result[i]);
+        if (model.find(key) < 0 || model.countLess(key) != (long)i || skipList.getByRank((long)i) != result[i])
+        {
+            printf("content mismatch at %zu\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// 随机插入删除，带前缀和不带前缀的两个跳表都与模型对照
+static bool verifyRandom(const std::vector<std::string> &keyArray, int opCount, uint64_t &state)
+{
+    SkipList cached{compareString, 0, SkipList::cstringPrefix};
+    SkipList plain{compareString};
+    Model model;
+
+    for (int i = 0; i < opCount; ++i)
+    {
+        auto random = nextRandom(state);
+        auto &key = keyArray[random % keyArray.size()];
+        auto index = model.find(key);
+        bool ok = true;
+        switch (random / 65536 % 4)
+        {
+        case 0:
+        case 1:
+            // 相同内容的键用同一个指针插入，模型中的指针就是跳表中的数据
+            ok = cached.insert(key.c_str()) == (index < 0) && plain.insert(key.c_str()) == (index < 0);
+            if (index < 0)
+            {
+                model.m_keyArray.push_back(&key);
+            }
+            break;
+        case 2:
+            ok = cached.remove(std::string{key}.c_str()) == (index >= 0) && plain.remove(std::string{key}.c_str()) == (index >= 0);
+            if (index >= 0)
+            {
+                model.m_keyArray.erase(model.m_keyArray.begin() + index);
+            }
+            break;
+        default:
+            ok = compareLookup(cached, model, key) && compareLookup(plain, model, key);
+            break;
+        }
+
+        if (!ok)
+        {
+            printf("mismatch at op %d, key \"%s\"\n", i, key.c_str());
+            return false;
+        }
+        if (i % 499 == 0 && !(compareAll(cached, model) && compareAll(plain, model)))
+        {
+            printf("at op %d\n", i);
+            return false;
+        }
+    }
+
+    return compareAll(cached, model) && compareAll(plain, model);
+}
+
+// 一组前8字节相同的键：逐个删除，每次删除后被删的键查不到，其余的键和相邻的键仍能查到且排名正确
+static bool verifySharedPrefix(const std::vector<std::string> &keyArray)
+{
+    SkipList cached{compareString, 0, SkipList::cstringPrefix};
+    Model model;
+    for (auto &key : keyArray)
+    {
+        if (cached.insert(key.c_str()))
+        {
+            model.m_keyArray.push_back(&key);
+        }
+    }
+
+    std::vector<const std::string *> groupArray;
+    for (auto key : model.m_keyArray)
+    {
+        if (key->compare(0, 8, "sharedpx") == 0)
+        {
+            groupArray.push_back(key);
+        }
+    }
+
+    for (auto key : groupArray)
+    {
+        if (!cached.remove(std::string{*key}.c_str()))
+        {
+            printf("remove \"%s\" failed\n", key->c_str());
+            return false;
+        }
+        model.m_keyArray.erase(model.m_keyArray.begin() + model.find(*key));
+
+        for (auto other : groupArray)
+        {
+            if (!compareLookup(cached, model, *other))
+            {
+                return false;
+            }
+        }
+        // 只差最后一个字节或长度的键
+        if (!compareLookup(cached, model, "sharedp") || !compareLookup(cached, model, "sharedpx") ||
+            !compareLookup(cached, model, "sharedpy"))
+        {
+            return false;
+        }
+    }
+
+    return !groupArray.empty() && compareAll(cached, model);
+}
+
+int main()
+{
+    printf("begin\n");
+
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    auto keyArray = makeKeys(state);
+
+    bool ok = true;
+    ok = verifyRandom(keyArray, 100000, state) && ok;
+    ok = verifySharedPrefix(keyArray) && ok;
+
+    printf("%s\n", ok ? "ok" : "FAILED");
+    printf("end\n");
+
+    return ok ? 0 : 1;
+}
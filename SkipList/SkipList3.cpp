@@ -40,6 +40,37 @@ int main()
         }
     }
 
+    for (auto data : skipList)
+    {
+        printf("%d ", data);
+    }
+    printf("\n");
+
+    for (auto it = skipList.rbegin(); it != skipList.rend(); ++it)
+    {
+        printf("%d ", *it);
+    }
+    printf("\n");
+
+    // 快照保持创建时的数据
+    auto snapshot = skipList.snapshot();
+    skipList.remove(5);
+    skipList.insert(11);
+    for (auto data : snapshot)
+    {
+        printf("%d ", data);
+    }
+    printf("(snapshot memory %zu)\n", skipList.snapshotMemory());
+
+    // 层高和内存总是可用，查找的比较次数只在编译时定义了SKIPLIST_STATS时统计
+    auto stats = skipList.stats();
+    printf("level %d, %.1f bytes/node", stats.m_level, stats.bytesPerNode());
+    if (stats.m_counting)
+    {
+        printf(", %llu searches, %.1f compares/search", stats.m_searchCount, stats.comparesPerSearch());
+    }
+    printf("\n");
+
     // std::cout << "#end" << std::endl;
     printf("end\n");
 
@@ -1,30 +1,239 @@
 #ifndef _SKIPLIST_H_
 #define _SKIPLIST_H_
 
+#include <cstddef>
 #include <cstdlib>
 #include <functional>
+#include <iterator>
+#include <map>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "SkipListAllocator.h"
+#include "SkipListLevelGen.h"
+#include "SkipListOpLog.h"
+#include "SkipListStats.h"
+#include "SkipListTraits.h"
 
-template <typename T, class CmpLess = std::less<T>>
+#ifdef _MSC_VER
+#include <xmmintrin.h>
+#endif
+
+// 是否把后继节点的数据复制到每一层中：默认对不超过指针大小的标量类型开启，
+// 可以为具体类型特化以关闭或开启
+template <typename T>
+struct SkipListInlineKey : std::integral_constant<bool, std::is_scalar<T>::value && sizeof(T) <= sizeof(void *)>
+{
+};
+
+// 节点的一层：后继及跨度
+template <class SkipNode, typename T, bool InlineKey>
+struct SkipListLevel
+{
+    void setNext(SkipNode *next) { m_next = next; }
+    // 后继的数据，要求后继不为空
+    const T &nextKey() const { return m_next->m_data; }
+
+    SkipNode *m_next = nullptr;
+    unsigned long m_span = 0;
+};
+
+// 同时保存后继数据副本的层，查找时不必访问后继节点即可决定是否前进，每层少一次缓存缺失
+template <class SkipNode, typename T>
+struct SkipListLevel<SkipNode, T, true>
+{
+    void setNext(SkipNode *next)
+    {
+        m_next = next;
+        if (next)
+        {
+            m_nextKey = next->m_data;
+        }
+    }
+    const T &nextKey() const { return m_nextKey; }
+
+    SkipNode *m_next = nullptr;
+    unsigned long m_span = 0;
+    T m_nextKey = T();
+};
+
+// LevelGen为SkipListDeterministicLevelGen时使用1-2-3确定性平衡模式：
+// 插入/删除时提升或降低节点层高，保证查找最坏O(log n)；改变层高需要重新分配节点，
+// 因此修改可能使指向其他数据的迭代器和指针失效，也不支持快照
+template <typename T, class CmpLess = std::less<T>, class Allocator = SkipListNewAllocator, class LevelGen = SkipListLevelGen<>>
 class SkipList
 {
 protected:
     struct SkipNode;
 
-    struct SkipLevel
-    {
-        SkipNode *m_next = nullptr;
-        unsigned long m_span = 0;
-    };
+    using SkipLevel = SkipListLevel<SkipNode, T, SkipListInlineKey<T>::value>;
 
     struct SkipNode
     {
+        template <typename... Args>
+        explicit SkipNode(Args &&...args) : m_data(std::forward<Args>(args)...) {}
+
         T m_data;
-        SkipLevel *m_levelArray = nullptr;
         SkipNode *m_prev = nullptr;
+        // 节点层高
+        unsigned char m_level = 0;
+        // 快照存在期间第0层的后继被修改过，旧的后继保存在m_historyMap中
+        bool m_versioned = false;
+        // 层数组，与节点一次分配，实际长度为节点层高
+        SkipLevel m_levelArray[1];
     };
 
 public:
-    SkipList();
+    // 双向只读迭代器，修改数据会破坏顺序，因此不提供可写迭代器；
+    // 前进/后退时预取之后将要访问的节点
+    class ConstIterator
+    {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T *;
+        using reference = const T &;
+
+        ConstIterator() = default;
+
+        reference operator*() const { return m_node->m_data; }
+        pointer operator->() const { return &m_node->m_data; }
+
+        ConstIterator &operator++();
+        ConstIterator operator++(int)
+        {
+            auto it = *this;
+            ++*this;
+            return it;
+        }
+        // end()后退得到最后一个节点
+        ConstIterator &operator--();
+        ConstIterator operator--(int)
+        {
+            auto it = *this;
+            --*this;
+            return it;
+        }
+
+        bool operator==(const ConstIterator &other) const { return m_node == other.m_node; }
+        bool operator!=(const ConstIterator &other) const { return m_node != other.m_node; }
+
+    private:
+        friend class SkipList;
+
+        ConstIterator(const SkipNode *node, const SkipList *skipList) : m_node{node}, m_skipList{skipList} {}
+
+        // 当前节点，nullptr表示end()
+        const SkipNode *m_node = nullptr;
+        const SkipList *m_skipList = nullptr;
+    };
+
+    using value_type = T;
+    using size_type = size_t;
+    using iterator = ConstIterator;
+    using const_iterator = ConstIterator;
+    using reverse_iterator = std::reverse_iterator<ConstIterator>;
+    using const_reverse_iterator = std::reverse_iterator<ConstIterator>;
+
+    // 只读快照：保持创建时的数据，之后的insert/remove等修改对快照不可见，遍历时既不复制数据也不阻塞修改。
+    // 快照存在期间，被修改的第0层后继指针会保存旧值，被删除的节点延迟到没有快照引用时才回收。
+    // 只支持正向遍历，快照不能比跳表存在得更久
+    class Snapshot
+    {
+    public:
+        class ConstIterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const T *;
+            using reference = const T &;
+
+            ConstIterator() = default;
+
+            reference operator*() const { return m_node->m_data; }
+            pointer operator->() const { return &m_node->m_data; }
+
+            ConstIterator &operator++()
+            {
+                m_node = m_snapshot->m_skipList->snapshotNext(m_node, m_snapshot->m_version);
+                return *this;
+            }
+            ConstIterator operator++(int)
+            {
+                auto it = *this;
+                ++*this;
+                return it;
+            }
+
+            bool operator==(const ConstIterator &other) const { return m_node == other.m_node; }
+            bool operator!=(const ConstIterator &other) const { return m_node != other.m_node; }
+
+        private:
+            friend class Snapshot;
+
+            ConstIterator(const SkipNode *node, const Snapshot *snapshot) : m_node{node}, m_snapshot{snapshot} {}
+
+            // 当前节点，nullptr表示end()
+            const SkipNode *m_node = nullptr;
+            const Snapshot *m_snapshot = nullptr;
+        };
+
+        using value_type = T;
+        using size_type = size_t;
+        using iterator = ConstIterator;
+        using const_iterator = ConstIterator;
+
+        Snapshot(Snapshot &&other) noexcept { *this = std::move(other); }
+        Snapshot &operator=(Snapshot &&other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                m_skipList = other.m_skipList;
+                m_head = other.m_head;
+                m_version = other.m_version;
+                m_length = other.m_length;
+                other.m_skipList = nullptr;
+            }
+            return *this;
+        }
+        Snapshot(const Snapshot &) = delete;
+        Snapshot &operator=(const Snapshot &) = delete;
+        ~Snapshot() { release(); }
+
+        const_iterator begin() const { return {m_skipList ? m_skipList->snapshotNext(m_head, m_version) : nullptr, this}; }
+        const_iterator end() const { return {nullptr, this}; }
+
+        size_type size() const { return m_length; }
+        bool empty() const { return m_length == 0; }
+
+        // 提前释放快照，之后不能再遍历
+        void release()
+        {
+            if (m_skipList)
+            {
+                m_skipList->releaseSnapshot(m_version);
+                m_skipList = nullptr;
+            }
+        }
+
+    private:
+        friend class SkipList;
+
+        Snapshot(SkipList *skipList, uint64_t version)
+            : m_skipList{skipList}, m_head{skipList->m_head}, m_version{version}, m_length{skipList->m_length} {}
+
+        SkipList *m_skipList = nullptr;
+        const SkipNode *m_head = nullptr;
+        uint64_t m_version = 0;
+        size_type m_length = 0;
+    };
+
+    explicit SkipList(const LevelGen &levelGen = LevelGen());
     ~SkipList();
 
     template <typename U>
@@ -32,37 +241,175 @@ public:
 
     template <typename U>
     bool insert(U &&data);
+    // 用args原地构造数据并插入：只有一个参数时先用它查重，确认不重复后才构造；
+    // 多个参数无法直接比较，只能先构造再查重，重复时销毁
+    template <typename... Args>
+    bool emplace(Args &&...args);
 
     template <typename U>
     bool remove(U &&data);
 
+    // 获取data的排名(从0开始)，不存在时返回-1
+    template <typename U>
+    long getRank(U &&data);
+    // 小于data的数据个数
+    template <typename U>
+    unsigned long countLess(U &&data);
+    // 获取排名为rank的数据，rank为负数时从尾部倒数，越界时返回nullptr
+    const T *getByRank(long rank);
+    // 获取排名在[start, stop]内的数据，start/stop为负数时从尾部倒数
+    void rangeByRank(long start, long stop, std::vector<const T *> &result);
+
+    const_iterator begin() const { return {m_head->m_levelArray[0].m_next, this}; }
+    const_iterator end() const { return {nullptr, this}; }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator{end()}; }
+    const_reverse_iterator rend() const { return const_reverse_iterator{begin()}; }
+    // 第一个不小于data的位置
+    template <typename U>
+    const_iterator lower_bound(U &&data);
+    // 第一个大于data的位置
+    template <typename U>
+    const_iterator upper_bound(U &&data);
+
+    size_type size() const { return m_length; }
+    bool empty() const { return m_length == 0; }
+
+    // 清空所有数据
+    void clear();
+    // 用有序数据[first, last)重建跳表，一次线性遍历完成，重复数据只保留一个；
+    // balanced为true时按排名确定层高，否则随机生成层高
+    template <typename InputIt>
+    void buildFromSorted(InputIt first, InputIt last, bool balanced = false);
+    // 批量插入/删除升序数据[first, last)，后一个数据从前一个数据的查找位置继续查找，
+    // 乱序的数据会退化为从头查找；返回成功插入/删除的个数
+    template <typename InputIt>
+    unsigned long insertBatch(InputIt first, InputIt last);
+    template <typename InputIt>
+    unsigned long removeBatch(InputIt first, InputIt last);
+
+    // 挂接操作日志：打开opLog并重放其中的操作，之后成功的修改都追加到日志，日志段过大时自动压缩；
+    // opLog为nullptr时取消挂接，不关闭日志。数据通过SkipListOpLogCodec<T>与字节转换
+    bool attachOpLog(SkipListOpLog *opLog);
+
+    // 创建只读快照
+    Snapshot snapshot();
+    // 快照为保留旧版本额外占用的内存字节数，包括被修改前的后继指针记录和延迟回收的节点；
+    // 只与最早的快照创建以来被修改或删除的节点数成正比，所有快照释放后降为0
+    size_t snapshotMemory() const;
+
+    // 统计信息：层高分布和内存占用每次遍历全部节点计算，总字节数包括snapshotMemory()；
+    // 查找计数器只在定义SKIPLIST_STATS时统计
+    SkipListStats stats() const;
+    // 清零查找计数器
+    void resetStats();
+
 protected:
     // 层高上限
-    const static unsigned char MAX_LEVEL = 32;
-    // 增加1层的概率参数
-    const static int LEVEL_THRESHOLD = 0.25 * RAND_MAX;
+    const static unsigned char MAX_LEVEL = LevelGen::MAX_LEVEL;
 
-    // 用户数据比较: a < b
+    // 比较器定义了is_transparent时，可以直接用任意能与T比较的类型查找
+    const static bool IS_TRANSPARENT = SkipListIsTransparent<CmpLess>::value;
+    // 查找参数的实际类型：比较器支持异构比较或者U就是T时原样引用，
+    // 否则先转换为T，整个查找过程只构造一次
     template <typename U>
-    bool customDataLess(U &&a, U &&b) { return m_cmpLess(a, b); }
+    using KeyArg = typename std::conditional<IS_TRANSPARENT || std::is_same<typename std::decay<U>::type, T>::value, U &&, T>::type;
+
+    // 1-2-3确定性平衡模式：
+    // 相邻两个高于j层的节点(头节点和链表末尾视为无限高)之间层高恰为j的节点称为j层的间隔，
+    // 除最高层外每个间隔有1~3个节点，最高层有1~3个节点，相当于2-3-4树，间隔即树的节点。
+    // 插入使间隔达到4个节点时把中间的节点提升一层(分裂)，删除使间隔为空时从相邻间隔借一个节点(旋转)或与之合并
+    const static bool DETERMINISTIC = SkipListIsDeterministic<LevelGen>::value;
+    // 调整过程中间隔的最大节点数
+    const static unsigned GAP_CAPACITY = 8;
+
+    // 用户数据比较: a < b
+    template <typename U, typename V>
+    bool customDataLess(U &&a, V &&b) { return m_cmpLess(a, b); }
     // 用户数据比较: a == b
-    template <typename U>
-    bool customDataEqual(U &&a, U &&b) { return !m_cmpLess(a, b) && !m_cmpLess(b, a); }
+    template <typename U, typename V>
+    bool customDataEqual(U &&a, V &&b) { return !m_cmpLess(a, b) && !m_cmpLess(b, a); }
 
     // 生成节点层高
-    unsigned char genLevel();
+    unsigned char genLevel() { return m_levelGen(); }
+
+    // 预取节点到缓存，只是提示，不会访问内存
+    static void prefetchNode(const SkipNode *node);
 
-    // 创建有level层的节点
-    SkipNode *createNode(unsigned char level);
+    // 有level层的节点占用的内存大小
+    static size_t nodeSize(unsigned char level) { return sizeof(SkipNode) + (level - 1) * sizeof(SkipLevel); }
+    // 创建有level层的节点，用args直接构造节点中的数据
+    template <typename... Args>
+    SkipNode *createNode(unsigned char level, Args &&...args);
     // 释放节点
     void releaseNode(SkipNode *node);
+    // 释放包括头节点在内的所有节点
+    void releaseAllNodes();
+
+    // 将新节点链接到updateArray记录的各层前驱之后
+    void linkNode(SkipNode *newNode, SkipNode **updateArray, unsigned long *rankArray);
+    // 将节点从各层摘除，updateArray为各层前驱，不释放节点
+    void unlinkNode(SkipNode *node, SkipNode **updateArray);
 
     // 找到最后一个小于data的节点，并返回updateArray和rankArray
     template <typename U>
     SkipNode *findLastLessThan(U &&data, SkipNode **updateArray, unsigned long *rankArray);
+    // 以updateArray和rankArray中上一次的查找结果为起点(finger)找到最后一个小于data的节点，
+    // 要求updateArray[0]小于data：先自底向上找到无需前进的层，再从该层以下重新查找
+    template <typename U>
+    SkipNode *findLastLessThanFrom(U &&data, SkipNode **updateArray, unsigned long *rankArray);
+    // 找到排名为rank(从1开始)的节点
+    SkipNode *findByRank(unsigned long rank);
+
+    // 确定性模式：统计以left为左边界的level层间隔中的节点个数，前GAP_CAPACITY个记录到gapArray
+    static unsigned countGap(SkipNode *left, unsigned char level, SkipNode **gapArray);
+    // 确定性模式：把节点的层高改为level，重新分配节点并链接到原来的位置，返回新节点
+    SkipNode *resizeNode(SkipNode *node, unsigned char level);
+    // 确定性模式：插入后自底向上分裂达到4个节点的间隔，updateArray为插入位置的各层前驱
+    void splitFullGaps(SkipNode **updateArray);
+    // 确定性模式：删除后自底向上填补空的间隔，leftArray[j]为删除位置所在的j层间隔的左边界，遇到不空的间隔即停止
+    void fillEmptyGaps(SkipNode **leftArray);
+    // 确定性模式：删除节点，updateArray为各层前驱
+    void removeBalanced(SkipNode *node, SkipNode **updateArray);
+    // 确定性模式：把所有节点的层高调整为按排名确定的平衡层高
+    void rebalanceByRank();
+
+    // 节点第0层的一个旧后继，对版本在[m_since, m_until)内的快照可见
+    struct NextRecord
+    {
+        const SkipNode *m_next;
+        uint64_t m_since;
+        uint64_t m_until;
+        NextRecord *m_older;
+    };
+    // 节点第0层后继的版本历史：m_since为当前后继生效的版本，m_records从新到旧排列
+    struct NextHistory
+    {
+        uint64_t m_since = 0;
+        NextRecord *m_records = nullptr;
+    };
+
+    // 修改node第0层的后继之前调用，有快照可能看到旧后继时保存旧值
+    void saveNext(SkipNode *node);
+    // 版本为version的快照中node第0层的后继
+    const SkipNode *snapshotNext(const SkipNode *node, uint64_t version) const;
+    // 释放已摘除的节点，有快照可能引用时延迟回收
+    void retireNode(SkipNode *node);
+    // 释放版本为version的快照，回收不再被任何快照引用的记录和节点
+    void releaseSnapshot(uint64_t version);
+    // 回收只被比最早的快照更旧的版本引用的记录和节点，没有快照时全部回收
+    void reclaimSnapshotMemory();
+
+    // 将对data的操作追加到操作日志，日志段过大时把全部数据交给操作日志在后台压缩
+    static void logOp(SkipList *skipList, SkipListOpLog::OpType type, const T &data);
+    // 重放操作日志中的一条记录，context为SkipList
+    static void replayOp(void *context, SkipListOpLog::OpType type, long long score, std::string_view bytes);
 
     // 用户数据比较对象
     CmpLess m_cmpLess;
+    // 节点内存分配器
+    Allocator m_allocator;
+    // 层高生成策略
+    LevelGen m_levelGen;
 
     SkipNode *m_head = nullptr;
     SkipNode *m_tail = nullptr;
@@ -71,36 +418,55 @@ protected:
     unsigned char m_level = 0;
     // 节点总数
     unsigned long m_length = 0;
+
+    // 挂接的操作日志，m_logOp只在attachOpLog中实例化，不使用操作日志时无需链接SkipListOpLog的实现
+    SkipListOpLog *m_opLog = nullptr;
+    void (*m_logOp)(SkipList *skipList, SkipListOpLog::OpType type, const T &data) = nullptr;
+
+    // 下一个快照的版本，快照创建后加1，之后的修改都属于更新的版本
+    uint64_t m_version = 0;
+    // 存在的快照：版本到个数
+    std::map<uint64_t, unsigned long> m_snapshotMap;
+    // 第0层后继被修改过的节点的版本历史
+    std::unordered_map<const SkipNode *, NextHistory> m_historyMap;
+    size_t m_recordCount = 0;
+    // 延迟回收的节点及其被删除时的版本
+    std::vector<std::pair<SkipNode *, uint64_t>> m_retiredArray;
+    size_t m_retiredBytes = 0;
+
+#ifdef SKIPLIST_STATS
+    // 查找计数器
+    SkipListCounters<MAX_LEVEL> m_counters;
+#endif
 };
 
-template <typename T, class CmpLess>
-SkipList<T, CmpLess>::SkipList()
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+SkipList<T, CmpLess, Allocator, LevelGen>::SkipList(const LevelGen &levelGen)
+    : m_levelGen{levelGen}
 {
     m_head = createNode(MAX_LEVEL);
     m_level = 1;
 }
 
-template <typename T, class CmpLess>
-SkipList<T, CmpLess>::~SkipList()
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+SkipList<T, CmpLess, Allocator, LevelGen>::~SkipList()
 {
-    while (m_head)
-    {
-        auto node = m_head;
-        m_head = m_head->m_levelArray[0].m_next;
-        releaseNode(node);
-    }
+    m_snapshotMap.clear();
+    reclaimSnapshotMemory();
+    releaseAllNodes();
 }
 
-template <typename T, class CmpLess>
+template <typename T, class CmpLess, class Allocator, class LevelGen>
 template <typename U>
-const T *SkipList<T, CmpLess>::find(U &&data)
+const T *SkipList<T, CmpLess, Allocator, LevelGen>::find(U &&data)
 {
     SkipNode *updateArray[MAX_LEVEL];
     unsigned long rankArray[MAX_LEVEL];
+    KeyArg<U> key(std::forward<U>(data));
 
-    findLastLessThan(std::forward<U>(data), updateArray, rankArray);
+    findLastLessThan(key, updateArray, rankArray);
     auto nextNode = updateArray[0]->m_levelArray[0].m_next;
-    if (nextNode && customDataEqual(std::forward<U>(nextNode->m_data), std::forward<U>(data)))
+    if (nextNode && customDataEqual(nextNode->m_data, key))
     {
         return &nextNode->m_data;
     }
@@ -108,175 +474,1149 @@ const T *SkipList<T, CmpLess>::find(U &&data)
     return nullptr;
 }
 
-template <typename T, class CmpLess>
+template <typename T, class CmpLess, class Allocator, class LevelGen>
 template <typename U>
-bool SkipList<T, CmpLess>::insert(U &&data)
+bool SkipList<T, CmpLess, Allocator, LevelGen>::insert(U &&data)
 {
     SkipNode *updateArray[MAX_LEVEL];
     unsigned long rankArray[MAX_LEVEL];
+    KeyArg<U> key(std::forward<U>(data));
 
-    findLastLessThan(std::forward<U>(data), updateArray, rankArray);
+    findLastLessThan(key, updateArray, rankArray);
     auto nextNode = updateArray[0]->m_levelArray[0].m_next;
-    if (nextNode && customDataEqual(std::forward<U>(nextNode->m_data), std::forward<U>(data)))
+    if (nextNode && customDataEqual(nextNode->m_data, key))
     {
         return false;
     }
 
-    auto level = genLevel();
-    auto newNode = createNode(level);
-    newNode->m_data = std::forward<U>(data);
+    auto newNode = createNode(genLevel(), std::forward<KeyArg<U>>(key));
+    linkNode(newNode, updateArray, rankArray);
 
-    if (level > m_level)
+    if (m_logOp)
     {
-        for (auto i = m_level; i < level; ++i)
-        {
-            updateArray[i] = m_head;
-            updateArray[i]->m_levelArray[i].m_span = m_length;
-            rankArray[i] = 0;
-        }
-        m_level = level;
+        m_logOp(this, SkipListOpLog::OP_INSERT, newNode->m_data);
     }
 
-    for (auto i = 0; i < level; ++i)
+    if constexpr (DETERMINISTIC)
     {
-        auto prevNode = updateArray[i];
-        auto &newNodeLevel = newNode->m_levelArray[i];
-        auto &prevNodeLevel = prevNode->m_levelArray[i];
-
-        newNodeLevel.m_next = prevNodeLevel.m_next;
-        prevNodeLevel.m_next = newNode;
-
-        newNodeLevel.m_span = rankArray[i] + prevNodeLevel.m_span - rankArray[0];
-        prevNodeLevel.m_span = rankArray[0] - rankArray[i] + 1;
+        splitFullGaps(updateArray);
     }
 
-    for (auto i = level; i < m_level; ++i)
-    {
-        updateArray[i]->m_levelArray[i].m_span++;
-    }
+    return true;
+}
 
-    if (newNode->m_levelArray[0].m_next)
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+template <typename... Args>
+bool SkipList<T, CmpLess, Allocator, LevelGen>::emplace(Args &&...args)
+{
+    if constexpr (sizeof...(Args) == 1)
     {
-        newNode->m_levelArray[0].m_next->m_prev = newNode;
+        return insert(std::forward<Args>(args)...);
     }
     else
     {
-        m_tail = newNode;
-    }
+        SkipNode *updateArray[MAX_LEVEL];
+        unsigned long rankArray[MAX_LEVEL];
 
-    newNode->m_prev = updateArray[0] == m_head ? nullptr : updateArray[0];
+        auto newNode = createNode(genLevel(), std::forward<Args>(args)...);
+        findLastLessThan(newNode->m_data, updateArray, rankArray);
+        auto nextNode = updateArray[0]->m_levelArray[0].m_next;
+        if (nextNode && customDataEqual(nextNode->m_data, newNode->m_data))
+        {
+            releaseNode(newNode);
+            return false;
+        }
 
-    m_length++;
+        linkNode(newNode, updateArray, rankArray);
 
-    return true;
+        if (m_logOp)
+        {
+            m_logOp(this, SkipListOpLog::OP_INSERT, newNode->m_data);
+        }
+
+        if constexpr (DETERMINISTIC)
+        {
+            splitFullGaps(updateArray);
+        }
+
+        return true;
+    }
 }
 
-template <typename T, class CmpLess>
+template <typename T, class CmpLess, class Allocator, class LevelGen>
 template <typename U>
-bool SkipList<T, CmpLess>::remove(U &&data)
+bool SkipList<T, CmpLess, Allocator, LevelGen>::remove(U &&data)
 {
     SkipNode *updateArray[MAX_LEVEL];
     unsigned long rankArray[MAX_LEVEL];
+    KeyArg<U> key(std::forward<U>(data));
 
-    findLastLessThan(std::forward<U>(data), updateArray, rankArray);
+    findLastLessThan(key, updateArray, rankArray);
 
     auto nextNode = updateArray[0]->m_levelArray[0].m_next;
-    if (!nextNode || !customDataEqual(std::forward<U>(nextNode->m_data), std::forward<U>(data)))
+    if (!nextNode || !customDataEqual(nextNode->m_data, key))
     {
         return false;
     }
 
-    for (auto i = 0; i < m_level; ++i)
+    if constexpr (DETERMINISTIC)
     {
-        auto curNode = updateArray[i];
-        if (curNode->m_levelArray[i].m_next == nextNode)
-        {
-            curNode->m_levelArray[i].m_next = nextNode->m_levelArray[i].m_next;
-            curNode->m_levelArray[i].m_span += nextNode->m_levelArray[i].m_span - 1;
-        }
-        else
-        {
-            curNode->m_levelArray[i].m_span--;
-        }
+        removeBalanced(nextNode, updateArray);
+        return true;
     }
 
-    if (nextNode->m_levelArray[0].m_next)
+    unlinkNode(nextNode, updateArray);
+    if (m_logOp)
     {
-        nextNode->m_levelArray[0].m_next->m_prev = nextNode->m_prev;
+        m_logOp(this, SkipListOpLog::OP_REMOVE, nextNode->m_data);
     }
-    else
+    retireNode(nextNode);
+
+    return true;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+template <typename U>
+typename SkipList<T, CmpLess, Allocator, LevelGen>::const_iterator SkipList<T, CmpLess, Allocator, LevelGen>::lower_bound(U &&data)
+{
+    SkipNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    KeyArg<U> key(std::forward<U>(data));
+
+    findLastLessThan(key, updateArray, rankArray);
+
+    return {updateArray[0]->m_levelArray[0].m_next, this};
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+template <typename U>
+typename SkipList<T, CmpLess, Allocator, LevelGen>::const_iterator SkipList<T, CmpLess, Allocator, LevelGen>::upper_bound(U &&data)
+{
+    SkipNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    KeyArg<U> key(std::forward<U>(data));
+
+    findLastLessThan(key, updateArray, rankArray);
+
+    // 数据不重复，等于data的节点最多一个
+    auto nextNode = updateArray[0]->m_levelArray[0].m_next;
+    if (nextNode && customDataEqual(nextNode->m_data, key))
     {
-        m_tail = nextNode->m_prev;
+        nextNode = nextNode->m_levelArray[0].m_next;
     }
 
-    while (m_level > 1 && m_head->m_levelArray[m_level - 1].m_next == nullptr)
+    return {nextNode, this};
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+template <typename U>
+long SkipList<T, CmpLess, Allocator, LevelGen>::getRank(U &&data)
+{
+    SkipNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    KeyArg<U> key(std::forward<U>(data));
+
+    findLastLessThan(key, updateArray, rankArray);
+
+    auto nextNode = updateArray[0]->m_levelArray[0].m_next;
+    if (!nextNode || !customDataEqual(nextNode->m_data, key))
     {
-        --m_level;
+        return -1;
     }
 
-    m_length--;
+    return rankArray[0];
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+template <typename U>
+unsigned long SkipList<T, CmpLess, Allocator, LevelGen>::countLess(U &&data)
+{
+    SkipNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    KeyArg<U> key(std::forward<U>(data));
 
-    releaseNode(nextNode);
+    findLastLessThan(key, updateArray, rankArray);
 
-    return true;
+    return rankArray[0];
 }
 
-template <typename T, class CmpLess>
-unsigned char SkipList<T, CmpLess>::genLevel()
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+const T *SkipList<T, CmpLess, Allocator, LevelGen>::getByRank(long rank)
 {
-    unsigned char level = 1;
-    while (level < MAX_LEVEL && rand() <= LEVEL_THRESHOLD)
-        ++level;
-    return level;
+    if (rank < 0)
+    {
+        rank += m_length;
+    }
+    if (rank < 0 || rank >= (long)m_length)
+    {
+        return nullptr;
+    }
+
+    return &findByRank(rank + 1)->m_data;
 }
 
-template <typename T, class CmpLess>
-typename SkipList<T, CmpLess>::SkipNode *SkipList<T, CmpLess>::createNode(unsigned char level)
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::rangeByRank(long start, long stop, std::vector<const T *> &result)
 {
-    auto node = new SkipNode;
-    node->m_levelArray = new SkipLevel[level];
-    return node;
+    result.clear();
+
+    if (start < 0)
+    {
+        start += m_length;
+    }
+    if (stop < 0)
+    {
+        stop += m_length;
+    }
+    if (start < 0)
+    {
+        start = 0;
+    }
+    if (stop >= (long)m_length)
+    {
+        stop = m_length - 1;
+    }
+    if (start > stop)
+    {
+        return;
+    }
+
+    result.reserve(stop - start + 1);
+    auto node = findByRank(start + 1);
+    for (auto i = start; i <= stop; ++i)
+    {
+        result.push_back(&node->m_data);
+        node = node->m_levelArray[0].m_next;
+    }
 }
 
-template <typename T, class CmpLess>
-void SkipList<T, CmpLess>::releaseNode(SkipNode *node)
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::clear()
 {
-    if (!node)
+    // 挂接了操作日志时逐个摘除第一个节点后再记录，日志中途压缩时复制的数据才与已记录的操作一致；
+    // 有快照时头节点和被删除的节点都要保留，同样只能逐个摘除
+    if (m_logOp || !m_snapshotMap.empty())
+    {
+        SkipNode *updateArray[MAX_LEVEL];
+        for (auto i = 0; i < MAX_LEVEL; ++i)
+        {
+            updateArray[i] = m_head;
+        }
+        while (auto node = m_head->m_levelArray[0].m_next)
+        {
+            unlinkNode(node, updateArray);
+            if (m_logOp)
+            {
+                m_logOp(this, SkipListOpLog::OP_REMOVE, node->m_data);
+            }
+            retireNode(node);
+        }
         return;
-    delete[] node->m_levelArray;
-    delete node;
+    }
+
+    releaseAllNodes();
+
+    m_head = createNode(MAX_LEVEL);
+    m_tail = nullptr;
+    m_level = 1;
+    m_length = 0;
 }
 
-template <typename T, class CmpLess>
-template <typename U>
-typename SkipList<T, CmpLess>::SkipNode *SkipList<T, CmpLess>::findLastLessThan(U &&data, SkipNode **updateArray, unsigned long *rankArray)
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+template <typename InputIt>
+void SkipList<T, CmpLess, Allocator, LevelGen>::buildFromSorted(InputIt first, InputIt last, bool balanced)
 {
-    auto curNode = m_head;
-    auto curLevel = m_level;
+    clear();
 
-    rankArray[curLevel - 1] = 0;
-    while (curLevel)
+    // 每层当前的最后一个节点及其排名
+    SkipNode *lastArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    for (auto i = 0; i < MAX_LEVEL; ++i)
     {
-        if (curLevel < m_level)
+        lastArray[i] = m_head;
+        rankArray[i] = 0;
+    }
+
+    for (; first != last; ++first)
+    {
+        const T &data = *first;
+        auto tailNode = lastArray[0];
+        if (tailNode != m_head && !m_cmpLess(tailNode->m_data, data))
         {
-            rankArray[curLevel - 1] = rankArray[curLevel];
+            if (!m_cmpLess(data, tailNode->m_data))
+            {
+                continue;
+            }
+
+            // 乱序数据：补齐各层末尾的跨度后退化为普通插入，再重新定位各层末尾节点
+            for (auto i = 0; i < m_level; ++i)
+            {
+                lastArray[i]->m_levelArray[i].m_span = m_length - rankArray[i];
+            }
+            m_tail = tailNode;
+
+            insert(data);
+
+            auto curNode = m_head;
+            unsigned long curRank = 0;
+            for (auto i = MAX_LEVEL; i > 0; --i)
+            {
+                while (curNode->m_levelArray[i - 1].m_next)
+                {
+                    curRank += curNode->m_levelArray[i - 1].m_span;
+                    curNode = curNode->m_levelArray[i - 1].m_next;
+                }
+                lastArray[i - 1] = curNode;
+                rankArray[i - 1] = curRank;
+            }
+            continue;
         }
 
-        auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
-        while (nextNode &&
-               customDataLess(std::forward<U>(nextNode->m_data), std::forward<U>(data)))
+        // 确定性模式先按排名生成层高，最后再修正末尾不平衡的少数节点
+        auto level = balanced || DETERMINISTIC ? LevelGen::rankLevel(m_length + 1) : genLevel();
+        auto newNode = createNode(level, data);
+        newNode->m_prev = tailNode == m_head ? nullptr : tailNode;
+
+        // 之后追加的节点都是新节点，快照看不到，只有头节点的后继需要保存
+        if (tailNode == m_head)
         {
-            rankArray[curLevel - 1] += curNode->m_levelArray[curLevel - 1].m_span;
-            curNode = nextNode;
-            nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+            saveNext(m_head);
         }
 
-        updateArray[curLevel - 1] = curNode;
+        m_length++;
 
-        --curLevel;
+        for (auto i = 0; i < level; ++i)
+        {
+            auto &prevNodeLevel = lastArray[i]->m_levelArray[i];
+            prevNodeLevel.setNext(newNode);
+            prevNodeLevel.m_span = m_length - rankArray[i];
+
+            lastArray[i] = newNode;
+            rankArray[i] = m_length;
+        }
+
+        if (level > m_level)
+        {
+            m_level = level;
+        }
+
+        if (m_logOp)
+        {
+            m_logOp(this, SkipListOpLog::OP_INSERT, newNode->m_data);
+        }
     }
 
-    return curNode;
+    for (auto i = 0; i < m_level; ++i)
+    {
+        lastArray[i]->m_levelArray[i].m_span = m_length - rankArray[i];
+    }
+    m_tail = lastArray[0] == m_head ? nullptr : lastArray[0];
+
+    if constexpr (DETERMINISTIC)
+    {
+        rebalanceByRank();
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+template <typename InputIt>
+unsigned long SkipList<T, CmpLess, Allocator, LevelGen>::insertBatch(InputIt first, InputIt last)
+{
+    SkipNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    bool hasFinger = false;
+    unsigned long count = 0;
+
+    // 确定性模式下调整层高会重新分配节点，finger中的前驱可能失效，只能逐个插入
+    if constexpr (DETERMINISTIC)
+    {
+        for (; first != last; ++first)
+        {
+            count += insert(*first);
+        }
+        return count;
+    }
+
+    for (; first != last; ++first)
+    {
+        const T &data = *first;
+        if (hasFinger && (updateArray[0] == m_head || customDataLess(updateArray[0]->m_data, data)))
+        {
+            findLastLessThanFrom(data, updateArray, rankArray);
+        }
+        else
+        {
+            findLastLessThan(data, updateArray, rankArray);
+            hasFinger = true;
+        }
+
+        auto nextNode = updateArray[0]->m_levelArray[0].m_next;
+        if (nextNode && customDataEqual(nextNode->m_data, data))
+        {
+            continue;
+        }
+
+        auto newNode = createNode(genLevel(), data);
+        linkNode(newNode, updateArray, rankArray);
+
+        if (m_logOp)
+        {
+            m_logOp(this, SkipListOpLog::OP_INSERT, newNode->m_data);
+        }
+
+        // 新节点成为其所在各层的前驱，供下一个数据继续查找
+        auto rank = rankArray[0] + 1;
+        for (auto i = 0; i < newNode->m_level; ++i)
+        {
+            updateArray[i] = newNode;
+            rankArray[i] = rank;
+        }
+
+        ++count;
+    }
+
+    return count;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+template <typename InputIt>
+unsigned long SkipList<T, CmpLess, Allocator, LevelGen>::removeBatch(InputIt first, InputIt last)
+{
+    SkipNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    bool hasFinger = false;
+    unsigned long count = 0;
+
+    // 确定性模式下调整层高会重新分配节点，finger中的前驱可能失效，只能逐个删除
+    if constexpr (DETERMINISTIC)
+    {
+        for (; first != last; ++first)
+        {
+            count += remove(*first);
+        }
+        return count;
+    }
+
+    for (; first != last; ++first)
+    {
+        const T &data = *first;
+        if (hasFinger && (updateArray[0] == m_head || customDataLess(updateArray[0]->m_data, data)))
+        {
+            findLastLessThanFrom(data, updateArray, rankArray);
+        }
+        else
+        {
+            findLastLessThan(data, updateArray, rankArray);
+            hasFinger = true;
+        }
+
+        auto nextNode = updateArray[0]->m_levelArray[0].m_next;
+        if (!nextNode || !customDataEqual(nextNode->m_data, data))
+        {
+            continue;
+        }
+
+        // 被删除节点之前的前驱和排名保持不变，可以继续作为finger
+        unlinkNode(nextNode, updateArray);
+        if (m_logOp)
+        {
+            m_logOp(this, SkipListOpLog::OP_REMOVE, nextNode->m_data);
+        }
+        retireNode(nextNode);
+
+        ++count;
+    }
+
+    return count;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+bool SkipList<T, CmpLess, Allocator, LevelGen>::attachOpLog(SkipListOpLog *opLog)
+{
+    static_assert(SkipListOpLogCodec<T>::SUPPORTED, "SkipListOpLogCodec<T> must be specialized to attach an op log");
+
+    // 重放时不能再写回日志
+    m_opLog = nullptr;
+    m_logOp = nullptr;
+    if (!opLog)
+    {
+        return true;
+    }
+
+    if (!opLog->open(replayOp, this))
+    {
+        return false;
+    }
+    m_opLog = opLog;
+    m_logOp = logOp;
+
+    return true;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+typename SkipList<T, CmpLess, Allocator, LevelGen>::Snapshot SkipList<T, CmpLess, Allocator, LevelGen>::snapshot()
+{
+    static_assert(!DETERMINISTIC, "snapshots are not supported in deterministic mode, which relocates nodes");
+
+    auto version = m_version++;
+    ++m_snapshotMap[version];
+    return Snapshot{this, version};
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+size_t SkipList<T, CmpLess, Allocator, LevelGen>::snapshotMemory() const
+{
+    // 哈希表按每个元素一个链表节点、每个桶一个指针估算
+    return m_recordCount * sizeof(NextRecord) +
+           m_historyMap.size() * (sizeof(typename decltype(m_historyMap)::value_type) + 2 * sizeof(void *)) +
+           (m_historyMap.empty() ? 0 : m_historyMap.bucket_count() * sizeof(void *)) +
+           m_retiredArray.capacity() * sizeof(m_retiredArray[0]) + m_retiredBytes;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+SkipListStats SkipList<T, CmpLess, Allocator, LevelGen>::stats() const
+{
+    SkipListStats stats;
+#ifdef SKIPLIST_STATS
+    stats.setCounters(m_counters);
+#endif
+    stats.m_length = m_length;
+    stats.countNodes(m_head, m_level, nodeSize);
+    stats.m_totalBytes = sizeof(*this) + nodeSize(MAX_LEVEL) + stats.m_nodeBytes + snapshotMemory();
+    return stats;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::resetStats()
+{
+#ifdef SKIPLIST_STATS
+    m_counters = {};
+#endif
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+template <typename... Args>
+typename SkipList<T, CmpLess, Allocator, LevelGen>::SkipNode *SkipList<T, CmpLess, Allocator, LevelGen>::createNode(unsigned char level, Args &&...args)
+{
+    auto memory = m_allocator.allocate(nodeSize(level), level);
+    auto node = new (memory) SkipNode(std::forward<Args>(args)...);
+    node->m_level = level;
+    for (auto i = 1; i < level; ++i)
+    {
+        new (&node->m_levelArray[i]) SkipLevel;
+    }
+    return node;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::releaseNode(SkipNode *node)
+{
+    if (!node)
+        return;
+    auto level = node->m_level;
+    node->~SkipNode();
+    m_allocator.deallocate(node, nodeSize(level), level);
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::releaseAllNodes()
+{
+    if (Allocator::BULK_RELEASE)
+    {
+        // 节点内存由分配器整体释放，这里只需析构用户数据
+        if (!std::is_trivially_destructible<T>::value)
+        {
+            while (m_head)
+            {
+                auto node = m_head;
+                m_head = m_head->m_levelArray[0].m_next;
+                node->~SkipNode();
+            }
+        }
+        m_allocator.releaseAll();
+        m_head = nullptr;
+        return;
+    }
+
+    while (m_head)
+    {
+        auto node = m_head;
+        m_head = m_head->m_levelArray[0].m_next;
+        releaseNode(node);
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::linkNode(SkipNode *newNode, SkipNode **updateArray, unsigned long *rankArray)
+{
+    auto level = newNode->m_level;
+
+    if (level > m_level)
+    {
+        for (auto i = m_level; i < level; ++i)
+        {
+            updateArray[i] = m_head;
+            updateArray[i]->m_levelArray[i].m_span = m_length;
+            rankArray[i] = 0;
+        }
+        m_level = level;
+    }
+
+    for (auto i = 0; i < level; ++i)
+    {
+        auto prevNode = updateArray[i];
+        auto &newNodeLevel = newNode->m_levelArray[i];
+        auto &prevNodeLevel = prevNode->m_levelArray[i];
+
+        if (i == 0)
+        {
+            saveNext(prevNode);
+        }
+
+        newNodeLevel = prevNodeLevel;
+        prevNodeLevel.setNext(newNode);
+
+        newNodeLevel.m_span = rankArray[i] + prevNodeLevel.m_span - rankArray[0];
+        prevNodeLevel.m_span = rankArray[0] - rankArray[i] + 1;
+    }
+
+    for (auto i = level; i < m_level; ++i)
+    {
+        updateArray[i]->m_levelArray[i].m_span++;
+    }
+
+    if (newNode->m_levelArray[0].m_next)
+    {
+        newNode->m_levelArray[0].m_next->m_prev = newNode;
+    }
+    else
+    {
+        m_tail = newNode;
+    }
+
+    newNode->m_prev = updateArray[0] == m_head ? nullptr : updateArray[0];
+
+    m_length++;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::unlinkNode(SkipNode *node, SkipNode **updateArray)
+{
+    for (auto i = 0; i < m_level; ++i)
+    {
+        auto curNode = updateArray[i];
+        if (curNode->m_levelArray[i].m_next == node)
+        {
+            if (i == 0)
+            {
+                saveNext(curNode);
+            }
+
+            auto span = curNode->m_levelArray[i].m_span;
+            curNode->m_levelArray[i] = node->m_levelArray[i];
+            curNode->m_levelArray[i].m_span += span - 1;
+        }
+        else
+        {
+            curNode->m_levelArray[i].m_span--;
+        }
+    }
+
+    if (node->m_levelArray[0].m_next)
+    {
+        node->m_levelArray[0].m_next->m_prev = node->m_prev;
+    }
+    else
+    {
+        m_tail = node->m_prev;
+    }
+
+    while (m_level > 1 && m_head->m_levelArray[m_level - 1].m_next == nullptr)
+    {
+        --m_level;
+    }
+
+    m_length--;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+template <typename U>
+typename SkipList<T, CmpLess, Allocator, LevelGen>::SkipNode *SkipList<T, CmpLess, Allocator, LevelGen>::findLastLessThan(U &&data, SkipNode **updateArray, unsigned long *rankArray)
+{
+    auto curNode = m_head;
+    auto curLevel = m_level;
+    SKIPLIST_COUNT(++m_counters.m_searchCount);
+
+    rankArray[curLevel - 1] = 0;
+    while (curLevel)
+    {
+        if (curLevel < m_level)
+        {
+            rankArray[curLevel - 1] = rankArray[curLevel];
+        }
+
+        auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        while (nextNode &&
+               customDataLess(curNode->m_levelArray[curLevel - 1].nextKey(), data))
+        {
+            SKIPLIST_COUNT(++m_counters.m_visitArray[curLevel - 1]);
+            rankArray[curLevel - 1] += curNode->m_levelArray[curLevel - 1].m_span;
+            curNode = nextNode;
+            nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        }
+        SKIPLIST_COUNT(m_counters.m_stopCount += nextNode != nullptr);
+
+        updateArray[curLevel - 1] = curNode;
+
+        --curLevel;
+    }
+
+    return curNode;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+template <typename U>
+typename SkipList<T, CmpLess, Allocator, LevelGen>::SkipNode *SkipList<T, CmpLess, Allocator, LevelGen>::findLastLessThanFrom(U &&data, SkipNode **updateArray, unsigned long *rankArray)
+{
+    // 某层的后继不小于data时，该层及以上各层的前驱都不需要前进
+    unsigned char level = 0;
+    SKIPLIST_COUNT(++m_counters.m_searchCount);
+    while (level < m_level)
+    {
+        auto &fingerLevel = updateArray[level]->m_levelArray[level];
+        SKIPLIST_COUNT(m_counters.m_stopCount += fingerLevel.m_next != nullptr);
+        if (!fingerLevel.m_next || !customDataLess(fingerLevel.nextKey(), data))
+        {
+            break;
+        }
+        ++level;
+    }
+
+    if (!level)
+    {
+        return updateArray[0];
+    }
+
+    auto curNode = updateArray[level - 1];
+    auto curRank = rankArray[level - 1];
+    auto curLevel = level;
+    while (curLevel)
+    {
+        auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        while (nextNode &&
+               customDataLess(curNode->m_levelArray[curLevel - 1].nextKey(), data))
+        {
+            SKIPLIST_COUNT(++m_counters.m_visitArray[curLevel - 1]);
+            curRank += curNode->m_levelArray[curLevel - 1].m_span;
+            curNode = nextNode;
+            nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        }
+        SKIPLIST_COUNT(m_counters.m_stopCount += nextNode != nullptr);
+
+        updateArray[curLevel - 1] = curNode;
+        rankArray[curLevel - 1] = curRank;
+
+        --curLevel;
+    }
+
+    return curNode;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+typename SkipList<T, CmpLess, Allocator, LevelGen>::SkipNode *SkipList<T, CmpLess, Allocator, LevelGen>::findByRank(unsigned long rank)
+{
+    auto curNode = m_head;
+    auto curLevel = m_level;
+    unsigned long curRank = 0;
+
+    while (curLevel)
+    {
+        auto nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        while (nextNode && curRank + curNode->m_levelArray[curLevel - 1].m_span <= rank)
+        {
+            curRank += curNode->m_levelArray[curLevel - 1].m_span;
+            curNode = nextNode;
+            nextNode = curNode->m_levelArray[curLevel - 1].m_next;
+        }
+
+        if (curRank == rank)
+        {
+            return curNode;
+        }
+
+        --curLevel;
+    }
+
+    return nullptr;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+typename SkipList<T, CmpLess, Allocator, LevelGen>::ConstIterator &SkipList<T, CmpLess, Allocator, LevelGen>::ConstIterator::operator++()
+{
+    m_node = m_node->m_levelArray[0].m_next;
+    if (m_node)
+    {
+        // 预取下一个节点；节点有第1层时再预取第1层的后继，它平均在BRANCHING个节点之后，
+        // 无需等待中间节点加载即可提前发起访存
+        prefetchNode(m_node->m_levelArray[0].m_next);
+        if (m_node->m_level > 1)
+        {
+            prefetchNode(m_node->m_levelArray[1].m_next);
+        }
+    }
+    return *this;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+typename SkipList<T, CmpLess, Allocator, LevelGen>::ConstIterator &SkipList<T, CmpLess, Allocator, LevelGen>::ConstIterator::operator--()
+{
+    m_node = m_node ? m_node->m_prev : m_skipList->m_tail;
+    if (m_node)
+    {
+        prefetchNode(m_node->m_prev);
+    }
+    return *this;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::prefetchNode(const SkipNode *node)
+{
+#ifdef _MSC_VER
+    _mm_prefetch(reinterpret_cast<const char *>(node), _MM_HINT_T0);
+#else
+    __builtin_prefetch(node);
+#endif
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::logOp(SkipList *skipList, SkipListOpLog::OpType type, const T &data)
+{
+    using Codec = SkipListOpLogCodec<T>;
+
+    auto opLog = skipList->m_opLog;
+    opLog->append(type, 0, Codec::toBytes(data));
+    if (!opLog->needCompaction())
+    {
+        return;
+    }
+
+    // 在当前线程中复制全部数据，写文件留给后台线程
+    std::vector<unsigned char> records;
+    for (auto node = skipList->m_head->m_levelArray[0].m_next; node; node = node->m_levelArray[0].m_next)
+    {
+        SkipListOpLog::encodeRecord(records, SkipListOpLog::OP_INSERT, 0, Codec::toBytes(node->m_data));
+    }
+    opLog->compact(std::move(records));
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::replayOp(void *context, SkipListOpLog::OpType type, long long score, std::string_view bytes)
+{
+    (void)score;
+    auto skipList = static_cast<SkipList *>(context);
+    if (type == SkipListOpLog::OP_INSERT)
+    {
+        skipList->insert(SkipListOpLogCodec<T>::fromBytes(bytes));
+    }
+    else if (type == SkipListOpLog::OP_REMOVE)
+    {
+        skipList->remove(SkipListOpLogCodec<T>::fromBytes(bytes));
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::saveNext(SkipNode *node)
+{
+    if (m_snapshotMap.empty())
+    {
+        return;
+    }
+
+    auto &history = m_historyMap[node];
+    node->m_versioned = true;
+
+    // 同一个版本内多次修改只需保存第一次修改前的后继
+    if (history.m_since == m_version)
+    {
+        return;
+    }
+
+    // 旧后继只对版本不小于history.m_since的快照可见
+    if (m_snapshotMap.rbegin()->first >= history.m_since)
+    {
+        history.m_records = new NextRecord{node->m_levelArray[0].m_next, history.m_since, m_version, history.m_records};
+        ++m_recordCount;
+    }
+    history.m_since = m_version;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+const typename SkipList<T, CmpLess, Allocator, LevelGen>::SkipNode *SkipList<T, CmpLess, Allocator, LevelGen>::snapshotNext(const SkipNode *node, uint64_t version) const
+{
+    auto next = node->m_levelArray[0].m_next;
+    if (!node->m_versioned)
+    {
+        return next;
+    }
+
+    auto &history = m_historyMap.find(node)->second;
+    if (history.m_since <= version)
+    {
+        return next;
+    }
+
+    for (auto record = history.m_records; record; record = record->m_older)
+    {
+        if (record->m_since <= version)
+        {
+            return record->m_next;
+        }
+    }
+
+    // 快照创建时node还不存在，不会走到这里
+    return nullptr;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::retireNode(SkipNode *node)
+{
+    if (m_snapshotMap.empty())
+    {
+        releaseNode(node);
+        return;
+    }
+
+    m_retiredArray.emplace_back(node, m_version);
+    m_retiredBytes += nodeSize(node->m_level);
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::releaseSnapshot(uint64_t version)
+{
+    auto it = m_snapshotMap.find(version);
+    if (--it->second == 0)
+    {
+        m_snapshotMap.erase(it);
+        reclaimSnapshotMemory();
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::reclaimSnapshotMemory()
+{
+    auto oldest = m_snapshotMap.empty() ? m_version : m_snapshotMap.begin()->first;
+
+    // 记录从新到旧排列，m_until递减，m_until不大于oldest的记录已经没有快照能看到
+    for (auto it = m_historyMap.begin(); it != m_historyMap.end();)
+    {
+        auto &history = it->second;
+        auto link = &history.m_records;
+        while (*link && (*link)->m_until > oldest)
+        {
+            link = &(*link)->m_older;
+        }
+        while (*link)
+        {
+            auto record = *link;
+            *link = record->m_older;
+            delete record;
+            --m_recordCount;
+        }
+
+        // 没有记录时所有快照都能直接使用当前后继
+        if (!history.m_records)
+        {
+            const_cast<SkipNode *>(it->first)->m_versioned = false;
+            it = m_historyMap.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // 节点在版本retired.second被删除，只有更旧的快照可能引用
+    size_t count = 0;
+    for (auto &retired : m_retiredArray)
+    {
+        if (retired.second <= oldest)
+        {
+            m_retiredBytes -= nodeSize(retired.first->m_level);
+            releaseNode(retired.first);
+        }
+        else
+        {
+            m_retiredArray[count++] = retired;
+        }
+    }
+    m_retiredArray.resize(count);
+    if (m_snapshotMap.empty())
+    {
+        m_retiredArray.shrink_to_fit();
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+unsigned SkipList<T, CmpLess, Allocator, LevelGen>::countGap(SkipNode *left, unsigned char level, SkipNode **gapArray)
+{
+    auto right = left->m_levelArray[level].m_next;
+    unsigned count = 0;
+    for (auto node = left->m_levelArray[level - 1].m_next; node != right; node = node->m_levelArray[level - 1].m_next)
+    {
+        if (count < GAP_CAPACITY)
+        {
+            gapArray[count] = node;
+        }
+        ++count;
+    }
+    return count;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+typename SkipList<T, CmpLess, Allocator, LevelGen>::SkipNode *SkipList<T, CmpLess, Allocator, LevelGen>::resizeNode(SkipNode *node, unsigned char level)
+{
+    SkipNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+
+    // 节点前驱的排名不受摘除影响，摘除后可以直接按原来的前驱链接
+    findLastLessThan(node->m_data, updateArray, rankArray);
+    unlinkNode(node, updateArray);
+
+    auto newNode = createNode(level, std::move(node->m_data));
+    releaseNode(node);
+    linkNode(newNode, updateArray, rankArray);
+
+    return newNode;
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::splitFullGaps(SkipNode **updateArray)
+{
+    // 查找只填充了当前最高层以下的前驱，更高层的左边界是头节点
+    auto searchLevel = m_level;
+    for (unsigned char level = 1; level < MAX_LEVEL - 1; ++level)
+    {
+        auto left = level < searchLevel ? updateArray[level] : m_head;
+        SkipNode *gapArray[GAP_CAPACITY];
+        if (countGap(left, level, gapArray) <= 3)
+        {
+            break;
+        }
+
+        // 提升第3个节点，左右各剩2个和1个；被提升的节点加入上一层同一个间隔，左边界不变
+        resizeNode(gapArray[2], level + 1);
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::fillEmptyGaps(SkipNode **leftArray)
+{
+    // 被重新分配的节点层高都不超过level + 1，leftArray中更高层的左边界始终有效
+    for (unsigned char level = 1; level < m_level; ++level)
+    {
+        SkipNode *gapArray[GAP_CAPACITY];
+        auto left = leftArray[level];
+        if (countGap(left, level, gapArray) > 0)
+        {
+            return;
+        }
+
+        // 上一层的间隔不空，左右边界中至少有一个层高恰为level + 1，属于上一层的间隔
+        auto right = left->m_levelArray[level].m_next;
+        if (right && right->m_level == level + 1)
+        {
+            auto count = countGap(right, level, gapArray);
+            resizeNode(right, level);
+            if (count >= 2)
+            {
+                // 右侧间隔的第一个节点提升为新的边界
+                resizeNode(gapArray[0], level + 1);
+                return;
+            }
+            // 否则右边界降为本层后与右侧间隔合并为2个节点，上一层的间隔少了一个节点
+        }
+        else if (left != m_head && left->m_level == level + 1)
+        {
+            // 左边界在本层的前驱是左侧间隔的左边界，从上一层间隔的左边界开始找；最高层的左边界是头节点
+            auto leftLeft = level + 1 < m_level ? leftArray[level + 1] : m_head;
+            while (leftLeft->m_levelArray[level].m_next != left)
+            {
+                leftLeft = leftLeft->m_levelArray[level].m_next;
+            }
+
+            auto count = countGap(leftLeft, level, gapArray);
+            resizeNode(left, level);
+            if (count >= 2)
+            {
+                // 左侧间隔的最后一个节点提升为新的边界
+                resizeNode(gapArray[count - 1], level + 1);
+                return;
+            }
+            // 否则左边界降为本层后与左侧间隔合并
+        }
+        else
+        {
+            return;
+        }
+    }
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::removeBalanced(SkipNode *node, SkipNode **updateArray)
+{
+    auto level = node->m_level;
+    auto successor = node->m_levelArray[0].m_next;
+    if (level == 1 || !successor || successor->m_level != 1)
+    {
+        unlinkNode(node, updateArray);
+        if (m_logOp)
+        {
+            m_logOp(this, SkipListOpLog::OP_REMOVE, node->m_data);
+        }
+        releaseNode(node);
+
+        fillEmptyGaps(updateArray);
+        return;
+    }
+
+    // 高节点：与2-3-4树删除内部键相同，把第0层的后继(层高必为1)的数据移到该节点，再删除后继
+    T data = std::move(node->m_data);
+    node->m_data = std::move(successor->m_data);
+    for (auto i = 0; i < level; ++i)
+    {
+        updateArray[i]->m_levelArray[i].setNext(node);
+        updateArray[i] = node;
+    }
+
+    unlinkNode(successor, updateArray);
+    releaseNode(successor);
+    if (m_logOp)
+    {
+        m_logOp(this, SkipListOpLog::OP_REMOVE, data);
+    }
+
+    fillEmptyGaps(updateArray);
+}
+
+template <typename T, class CmpLess, class Allocator, class LevelGen>
+void SkipList<T, CmpLess, Allocator, LevelGen>::rebalanceByRank()
+{
+    // 按排名生成的层高只在每层末尾和最高几层与平衡层高不同，需要调整的节点数为O(log n)
+    std::vector<std::pair<SkipNode *, unsigned char>> resizeArray;
+    unsigned long index = 0;
+    for (auto node = m_head->m_levelArray[0].m_next; node; node = node->m_levelArray[0].m_next, ++index)
+    {
+        auto level = LevelGen::balancedLevel(index, m_length);
+        if (level != node->m_level)
+        {
+            resizeArray.emplace_back(node, level);
+        }
+    }
+
+    for (auto &resize : resizeArray)
+    {
+        resizeNode(resize.first, resize.second);
+    }
 }
 
-#endif // _SKIPLIST_H_
\ No newline at end of file
+#endif // _SKIPLIST_H_
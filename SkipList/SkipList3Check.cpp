@@ -0,0 +1,444 @@
+// SkipList3与std::set模型对照的测试：
+//   g++ -std=c++17 -O2 SkipList3Check.cpp -o skiplist3_check
+// 随机层高和确定性平衡两种模式都运行随机的单个/批量插入删除、buildFromSorted，
+// 对照内容、排名查询和各层结构；随机层高模式另外检查快照在之后的修改中保持创建时的内容。
+// 全部检查通过时返回0。
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <set>
+#include <vector>
+#include "SkipList3.h"
+
+// 访问内部结构，检查各层跨度、后继数据副本、m_prev/m_tail，以及确定性模式的1-2-3间隔
+template <class LevelGen>
+class CheckedSkipList : public SkipList<long long, std::less<long long>, SkipListPoolAllocator, LevelGen>
+{
+    using Base = SkipList<long long, std::less<long long>, SkipListPoolAllocator, LevelGen>;
+
+public:
+    bool checkStructure() const
+    {
+        auto head = this->m_head;
+
+        // 节点在第0层的排名，用于核对各层跨度
+        std::vector<const typename Base::SkipNode *> nodeArray{head};
+        unsigned char topLevel = 0;
+        for (auto node = head->m_levelArray[0].m_next; node; node = node->m_levelArray[0].m_next)
+        {
+            if (node->m_prev != (nodeArray.size() > 1 ? nodeArray.back() : nullptr))
+            {
+                printf("bad prev at rank %zu\n", nodeArray.size());
+                return false;
+            }
+            nodeArray.push_back(node);
+            topLevel = std::max(topLevel, node->m_level);
+        }
+        if (nodeArray.size() - 1 != this->m_length || this->m_tail != (this->m_length ? nodeArray.back() : nullptr))
+        {
+            printf("bad length or tail\n");
+            return false;
+        }
+
+        for (unsigned char i = 0; i < this->m_level; ++i)
+        {
+            size_t rank = 0;
+            for (auto node = head; node; node = node->m_levelArray[i].m_next)
+            {
+                auto &level = node->m_levelArray[i];
+                auto nextRank = level.m_next ? (size_t)(std::find(nodeArray.begin() + rank + 1, nodeArray.end(), level.m_next) - nodeArray.begin())
+                                             : nodeArray.size();
+                // 最后一个节点的跨度是到表尾的距离
+                auto span = level.m_next ? nextRank - rank : this->m_length - rank;
+                if (level.m_span != span || (level.m_next && (level.m_next->m_level <= i || level.nextKey() != level.m_next->m_data)))
+                {
+                    printf("bad span or next key at level %d, rank %zu\n", i, rank);
+                    return false;
+                }
+                rank = nextRank;
+            }
+        }
+
+        if constexpr (Base::DETERMINISTIC)
+        {
+            if (this->m_length && this->m_level != topLevel)
+            {
+                printf("level %d, highest node %d\n", this->m_level, topLevel);
+                return false;
+            }
+            // j层的间隔由相邻两个高于j层的节点分隔，除最高层外每个间隔1~3个节点，最高层共1~3个节点
+            for (unsigned char j = 1; j <= topLevel; ++j)
+            {
+                unsigned count = 0, total = 0;
+                for (auto node = head->m_levelArray[j - 1].m_next; node; node = node->m_levelArray[j - 1].m_next)
+                {
+                    if (node->m_level > j)
+                    {
+                        if (count < 1 || count > 3)
+                        {
+                            printf("gap of %u nodes at level %d\n", count, j);
+                            return false;
+                        }
+                        count = 0;
+                        continue;
+                    }
+                    ++count;
+                    ++total;
+                }
+                if ((j < topLevel && (count < 1 || count > 3)) || (j == topLevel && (total < 1 || total > 3)))
+                {
+                    printf("last gap of %u nodes at level %d\n", j < topLevel ? count : total, j);
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+};
+
+// xorshift64，生成测试用的键
+static uint64_t nextRandom(uint64_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// 按顺序遍历得到的全部数据
+template <class Container>
+static std::vector<long long> collect(const Container &container)
+{
+    return std::vector<long long>(container.begin(), container.end());
+}
+
+// 内容、正反向遍历和抽样的排名查询逐项对照
+template <class LevelGen>
+static bool compareAll(CheckedSkipList<LevelGen> &skipList, const std::set<long long> &model, uint64_t &state)
+{
+    std::vector<long long> expected(model.begin(), model.end());
+    if (skipList.size() != model.size() || collect(skipList) != expected ||
+        !std::equal(skipList.rbegin(), skipList.rend(), expected.rbegin(), expected.rend()))
+    {
+        printf("content mismatch, size %zu, expected %zu\n", skipList.size(), model.size());
+        return false;
+    }
+
+    for (size_t i = 0; i < expected.size(); i += 1 + expected.size() / 32)
+    {
+        auto data = skipList.getByRank((long)i);
+        auto last = skipList.getByRank(-1 - (long)i);
+        if (!data || *data != expected[i] || !last || *last != expected[expected.size() - 1 - i] ||
+            skipList.getRank(expected[i]) != (long)i)
+        {
+            printf("rank mismatch at %zu\n", i);
+            return false;
+        }
+    }
+    if (skipList.getByRank((long)expected.size()) || skipList.getByRank(-1 - (long)expected.size()))
+    {
+        printf("getByRank out of range\n");
+        return false;
+    }
+
+    // 不在集合中的键也要给出正确的countLess
+    for (int i = 0; i < 16; ++i)
+    {
+        auto key = (long long)(nextRandom(state) % 4096);
+        auto less = (unsigned long)std::distance(model.begin(), model.lower_bound(key));
+        if (skipList.countLess(key) != less)
+        {
+            printf("countLess(%lld) mismatch\n", key);
+            return false;
+        }
+    }
+
+    return skipList.checkStructure();
+}
+
+// 有序的随机键，sorted为false时打乱顺序，批量操作退化为逐个从头查找
+static std::vector<long long> randomBatch(uint64_t &state, int keyRange, bool sorted)
+{
+    std::vector<long long> batch(nextRandom(state) % 33);
+    for (auto &key : batch)
+    {
+        key = (long long)(nextRandom(state) % keyRange);
+    }
+    std::sort(batch.begin(), batch.end());
+    if (!sorted)
+    {
+        std::reverse(batch.begin(), batch.end());
+    }
+    return batch;
+}
+
+// 随机的insert/emplace/remove/insertBatch/removeBatch/find/getRank/countLess/getByRank/rangeByRank/lower_bound
+template <class LevelGen>
+static bool verifyRandom(const char *name, int keyRange, int opCount, uint64_t seed)
+{
+    CheckedSkipList<LevelGen> skipList;
+    std::set<long long> model;
+
+    uint64_t state = seed;
+    for (int i = 0; i < opCount; ++i)
+    {
+        auto random = nextRandom(state);
+        auto key = (long long)(random % keyRange);
+        bool ok = true;
+        switch (random / 65536 % 16)
+        {
+        case 0:
+        case 1:
+        case 2:
+            ok = skipList.insert(key) == model.insert(key).second;
+            break;
+        case 3:
+            ok = skipList.emplace(key) == model.insert(key).second;
+            break;
+        case 4:
+        case 5:
+            ok = skipList.remove(key) == (model.erase(key) > 0);
+            break;
+        case 6:
+        case 7:
+        {
+            auto batch = randomBatch(state, keyRange, random & 1);
+            unsigned long expected = 0;
+            for (auto data : batch)
+            {
+                expected += model.insert(data).second;
+            }
+            ok = skipList.insertBatch(batch.begin(), batch.end()) == expected;
+            break;
+        }
+        case 8:
+        case 9:
+        {
+            auto batch = randomBatch(state, keyRange, random & 1);
+            unsigned long expected = 0;
+            for (auto data : batch)
+            {
+                expected += model.erase(data);
+            }
+            ok = skipList.removeBatch(batch.begin(), batch.end()) == expected;
+            break;
+        }
+        case 10:
+        {
+            auto data = skipList.find(key);
+            ok = model.count(key) ? data && *data == key : !data;
+            break;
+        }
+        case 11:
+        {
+            auto it = model.find(key);
+            ok = skipList.getRank(key) == (it == model.end() ? -1 : (long)std::distance(model.begin(), it));
+            break;
+        }
+        case 12:
+            ok = skipList.countLess(key) == (unsigned long)std::distance(model.begin(), model.lower_bound(key));
+            break;
+        case 13:
+        {
+            long rank = (long)(random / 1048576 % 64) - 32;
+            auto data = skipList.getByRank(rank);
+            auto index = rank < 0 ? rank + (long)model.size() : rank;
+            ok = index >= 0 && index < (long)model.size() ? data && *data == *std::next(model.begin(), index) : !data;
+            break;
+        }
+        case 14:
+        {
+            long start = (long)(random / 1048576 % 40) - 20;
+            long stop = start + (long)(random / 1024 % 8);
+            std::vector<const long long *> result;
+            skipList.rangeByRank(start, stop, result);
+
+            long length = (long)model.size();
+            auto first = std::max(start < 0 ? start + length : start, 0L);
+            auto last = std::min(stop < 0 ? stop + length : stop, length - 1);
+            ok = result.size() == (size_t)std::max(last - first + 1, 0L);
+            auto it = first < length ? std::next(model.begin(), first) : model.end();
+            for (size_t j = 0; ok && j < result.size(); ++j, ++it)
+            {
+                ok = *result[j] == *it;
+            }
+            break;
+        }
+        default:
+        {
+            auto lower = skipList.lower_bound(key);
+            auto upper = skipList.upper_bound(key);
+            auto modelLower = model.lower_bound(key);
+            auto modelUpper = model.upper_bound(key);
+            ok = (lower == skipList.end() ? modelLower == model.end() : modelLower != model.end() && *lower == *modelLower) &&
+                 (upper == skipList.end() ? modelUpper == model.end() : modelUpper != model.end() && *upper == *modelUpper);
+            break;
+        }
+        }
+
+        if (!ok)
+        {
+            printf("%s: mismatch at op %d, key %lld\n", name, i, key);
+            return false;
+        }
+        if (i % 997 == 0 && !compareAll(skipList, model, state))
+        {
+            printf("%s: at op %d\n", name, i);
+            return false;
+        }
+    }
+
+    return compareAll(skipList, model, state);
+}
+
+// buildFromSorted：含重复数据的有序输入，随机层高和按排名确定层高两种方式，重建后继续修改
+template <class LevelGen>
+static bool verifyBuild(const char *name, uint64_t seed)
+{
+    uint64_t state = seed;
+    for (int round = 0; round < 20; ++round)
+    {
+        std::vector<long long> input(nextRandom(state) % 3000);
+        for (auto &key : input)
+        {
+            key = (long long)(nextRandom(state) % 4096);
+        }
+        std::sort(input.begin(), input.end());
+        std::set<long long> model(input.begin(), input.end());
+
+        CheckedSkipList<LevelGen> skipList;
+        skipList.insert(-1);
+        skipList.buildFromSorted(input.begin(), input.end(), round % 2 == 0);
+        if (!compareAll(skipList, model, state))
+        {
+            printf("%s: build failed in round %d, size %zu\n", name, round, input.size());
+            return false;
+        }
+
+        for (int i = 0; i < 500; ++i)
+        {
+            auto key = (long long)(nextRandom(state) % 4096);
+            if (i % 2 ? skipList.insert(key) != model.insert(key).second : skipList.remove(key) != (model.erase(key) > 0))
+            {
+                printf("%s: mismatch after build in round %d\n", name, round);
+                return false;
+            }
+        }
+        if (!compareAll(skipList, model, state))
+        {
+            printf("%s: round %d\n", name, round);
+            return false;
+        }
+    }
+    return true;
+}
+
+// 快照：每轮创建快照后做一批单个和批量的修改，之前的各个快照仍然按创建时的内容遍历；
+// 乱序释放快照，全部释放后不再占用额外内存
+static bool verifySnapshot(uint64_t seed)
+{
+    using Checked = CheckedSkipList<SkipListLevelGen<>>;
+    Checked skipList;
+    std::set<long long> model;
+    uint64_t state = seed;
+    for (int i = 0; i < 2000; ++i)
+    {
+        auto key = (long long)(nextRandom(state) % 4096);
+        skipList.insert(key);
+        model.insert(key);
+    }
+
+    std::vector<Checked::Snapshot> snapshotArray;
+    std::vector<std::vector<long long>> expectedArray;
+    for (int round = 0; round < 30; ++round)
+    {
+        snapshotArray.push_back(skipList.snapshot());
+        expectedArray.emplace_back(model.begin(), model.end());
+
+        for (int i = 0; i < 200; ++i)
+        {
+            auto random = nextRandom(state);
+            auto key = (long long)(random % 4096);
+            switch (random / 65536 % 4)
+            {
+            case 0:
+                skipList.insert(key);
+                model.insert(key);
+                break;
+            case 1:
+                skipList.remove(key);
+                model.erase(key);
+                break;
+            case 2:
+            {
+                auto batch = randomBatch(state, 4096, true);
+                skipList.insertBatch(batch.begin(), batch.end());
+                model.insert(batch.begin(), batch.end());
+                break;
+            }
+            default:
+            {
+                auto batch = randomBatch(state, 4096, true);
+                skipList.removeBatch(batch.begin(), batch.end());
+                for (auto data : batch)
+                {
+                    model.erase(data);
+                }
+                break;
+            }
+            }
+        }
+
+        for (size_t i = 0; i < snapshotArray.size(); ++i)
+        {
+            if (snapshotArray[i].size() != expectedArray[i].size() || collect(snapshotArray[i]) != expectedArray[i])
+            {
+                printf("snapshot %zu changed in round %d\n", i, round);
+                return false;
+            }
+        }
+        if (!compareAll(skipList, model, state))
+        {
+            printf("snapshot round %d\n", round);
+            return false;
+        }
+
+        // 不时释放中间的快照，其余快照不受影响
+        if (round % 4 == 3)
+        {
+            auto index = nextRandom(state) % snapshotArray.size();
+            snapshotArray.erase(snapshotArray.begin() + index);
+            expectedArray.erase(expectedArray.begin() + index);
+        }
+    }
+
+    snapshotArray.clear();
+    if (skipList.snapshotMemory() != 0)
+    {
+        printf("snapshot memory %zu after release\n", skipList.snapshotMemory());
+        return false;
+    }
+    return compareAll(skipList, model, state);
+}
+
+int main()
+{
+    printf("begin\n");
+
+    bool ok = true;
+    ok = verifyRandom<SkipListLevelGen<>>("random", 100, 100000, 0x9e3779b97f4a7c15ull) && ok;
+    ok = verifyRandom<SkipListLevelGen<>>("random", 4096, 200000, 0x2545f4914f6cdd1dull) && ok;
+    ok = verifyRandom<SkipListDeterministicLevelGen<>>("deterministic", 100, 100000, 0x9e3779b97f4a7c15ull) && ok;
+    ok = verifyRandom<SkipListDeterministicLevelGen<>>("deterministic", 4096, 200000, 0x2545f4914f6cdd1dull) && ok;
+    ok = verifyBuild<SkipListLevelGen<>>("random", 0x853c49e6748fea9bull) && ok;
+    ok = verifyBuild<SkipListDeterministicLevelGen<>>("deterministic", 0x853c49e6748fea9bull) && ok;
+    ok = verifySnapshot(0xda942042e4dd58b5ull) && ok;
+
+    printf("%s\n", ok ? "ok" : "FAILED");
+    printf("end\n");
+
+    return ok ? 0 : 1;
+}
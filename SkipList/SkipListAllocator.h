@@ -0,0 +1,145 @@
+#ifndef _SKIPLIST_ALLOCATOR_H_
+#define _SKIPLIST_ALLOCATOR_H_
+
+#include <climits>
+#include <cstddef>
+#include <new>
+
+// 默认节点分配器：直接使用operator new/delete
+class SkipListNewAllocator
+{
+public:
+    // 是否支持通过releaseAll整体释放所有节点内存
+    const static bool BULK_RELEASE = false;
+
+    void *allocate(size_t size, unsigned char level);
+    void deallocate(void *ptr, size_t size, unsigned char level);
+    void releaseAll() {}
+};
+
+// 按层高分级的节点池：
+// 每种层高对应一个空闲链表，新内存从大块arena中顺序切分，
+// 释放的节点挂回对应层高的空闲链表，releaseAll时整体归还所有内存块。
+// 同一层高的节点大小必须相同，因此一个分配器只能服务一种节点类型。
+class SkipListPoolAllocator
+{
+public:
+    const static bool BULK_RELEASE = true;
+
+    explicit SkipListPoolAllocator(size_t blockSize = DEFAULT_BLOCK_SIZE);
+    ~SkipListPoolAllocator();
+
+    SkipListPoolAllocator(const SkipListPoolAllocator &) = delete;
+    SkipListPoolAllocator &operator=(const SkipListPoolAllocator &) = delete;
+
+    void *allocate(size_t size, unsigned char level);
+    void deallocate(void *ptr, size_t size, unsigned char level);
+    // 整体释放所有内存块
+    void releaseAll();
+
+protected:
+    // 默认内存块大小
+    const static size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+    // 节点对齐
+    const static size_t ALIGNMENT = alignof(std::max_align_t);
+
+    struct FreeNode
+    {
+        FreeNode *m_next;
+    };
+
+    struct Block
+    {
+        Block *m_next;
+    };
+
+    // 申请至少能容纳size字节的新内存块
+    void allocateBlock(size_t size);
+
+    size_t m_blockSize;
+    // 已申请的内存块链表
+    Block *m_blockList = nullptr;
+    // 当前内存块中未切分的区间
+    char *m_cursor = nullptr;
+    char *m_end = nullptr;
+    // 各层高的空闲链表
+    FreeNode *m_freeList[UCHAR_MAX + 1] = {};
+};
+
+inline void *SkipListNewAllocator::allocate(size_t size, unsigned char)
+{
+    return ::operator new(size);
+}
+
+inline void SkipListNewAllocator::deallocate(void *ptr, size_t, unsigned char)
+{
+    ::operator delete(ptr);
+}
+
+inline SkipListPoolAllocator::SkipListPoolAllocator(size_t blockSize)
+    : m_blockSize{blockSize}
+{
+}
+
+inline SkipListPoolAllocator::~SkipListPoolAllocator()
+{
+    releaseAll();
+}
+
+inline void *SkipListPoolAllocator::allocate(size_t size, unsigned char level)
+{
+    auto freeNode = m_freeList[level];
+    if (freeNode)
+    {
+        m_freeList[level] = freeNode->m_next;
+        return freeNode;
+    }
+
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if ((size_t)(m_end - m_cursor) < size)
+    {
+        allocateBlock(size);
+    }
+
+    auto ptr = m_cursor;
+    m_cursor += size;
+    return ptr;
+}
+
+inline void SkipListPoolAllocator::deallocate(void *ptr, size_t, unsigned char level)
+{
+    auto freeNode = static_cast<FreeNode *>(ptr);
+    freeNode->m_next = m_freeList[level];
+    m_freeList[level] = freeNode;
+}
+
+inline void SkipListPoolAllocator::releaseAll()
+{
+    while (m_blockList)
+    {
+        auto block = m_blockList;
+        m_blockList = m_blockList->m_next;
+        ::operator delete(block);
+    }
+
+    m_cursor = nullptr;
+    m_end = nullptr;
+    for (auto &freeList : m_freeList)
+    {
+        freeList = nullptr;
+    }
+}
+
+inline void SkipListPoolAllocator::allocateBlock(size_t size)
+{
+    // 块头占用一个对齐单位，保证切分出的节点依然对齐
+    auto blockSize = ALIGNMENT + (size > m_blockSize ? size : m_blockSize);
+    auto block = static_cast<Block *>(::operator new(blockSize));
+    block->m_next = m_blockList;
+    m_blockList = block;
+
+    m_cursor = reinterpret_cast<char *>(block) + ALIGNMENT;
+    m_end = reinterpret_cast<char *>(block) + blockSize;
+}
+
+#endif // _SKIPLIST_ALLOCATOR_H_
@@ -0,0 +1,1033 @@
+// 跳表与std::set、std::map、B+树的对比基准测试。
+// SkipList1/2/3都定义了类SkipList，不能链接到同一个程序，编译时用SKIPLIST_BENCH选择其中一个(默认为3)：
+//   g++ -std=c++17 -O2 -DNDEBUG -DSKIPLIST_BENCH=1 SkipListBench.cpp SkipList1.cpp SkipListOpLog.cpp -pthread -o bench1
+//   g++ -std=c++17 -O2 -DNDEBUG -DSKIPLIST_BENCH=2 SkipListBench.cpp SkipList2.cpp -o bench2
+//   g++ -std=c++17 -O2 -DNDEBUG -DSKIPLIST_BENCH=3 SkipListBench.cpp -o bench3
+// 用法：bench [-n 1000,100000,1000000] [-o 每个负载的操作数] [-c skiplist,skiplist-det,set,map,btree] [-d random,sequential] [-s 种子]
+// skiplist-det(显示为skiplist3d)只在SKIPLIST_BENCH=3时可用，是SkipListDeterministicLevelGen的确定性平衡模式，
+// 与随机层高的skiplist3对比各负载的吞吐和尾延迟。
+//
+// 数据集random为随机键，sequential为从1开始的顺序键，按生成顺序加载后依次运行各负载。
+// 操作序列只由种子决定，同一负载在各容器上的check相同，不同的check说明容器的行为不一致。
+// 每个(数据量, 数据集, 容器)在fork出的子进程中运行，mem为子进程峰值RSS相对开始时的增长，各容器互不影响。
+// 每STRIDE个操作对1个单独计时得到延迟分位数，计时开销(约20ns)只影响被计时的操作；
+// cache miss来自perf_event，不可用时(非Linux或没有权限)显示为-。
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#ifndef SKIPLIST_BENCH
+#define SKIPLIST_BENCH 3
+#endif
+
+#if SKIPLIST_BENCH == 1
+#include "SkipList1.h"
+#elif SKIPLIST_BENCH == 2
+#include "SkipList2.h"
+#else
+#include "SkipList3.h"
+#endif
+
+// 每STRIDE个操作单独计时1个
+const static unsigned long STRIDE = 8;
+// 范围扫描每次读取的键数
+const static int SCAN_LENGTH = 100;
+
+// 消耗操作结果，避免操作被编译器优化掉
+static volatile long long s_sink = 0;
+
+// splitmix64，由序号生成可重现的随机数
+static uint64_t mix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// xorshift64，操作序列中的随机数
+static uint64_t nextRandom(uint64_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// 非0的正随机键，SkipList2把键直接作为数据指针，0表示不存在
+static long long randomKey(uint64_t &state)
+{
+    return (long long)(nextRandom(state) >> 2) + 1;
+}
+
+// Zipf分布(YCSB的生成算法，theta = 0.99)：返回[0, n)内的序号，0最热。
+// 构造时计算zeta(n)需要O(n)，每个数据量只构造一次
+class ZipfGen
+{
+public:
+    explicit ZipfGen(uint64_t n, double theta = 0.99) : m_n{n}, m_theta{theta}
+    {
+        double zetaN = 0;
+        for (uint64_t i = 1; i <= n; ++i)
+        {
+            zetaN += 1 / std::pow((double)i, theta);
+        }
+        auto zeta2 = 1 + 1 / std::pow(2.0, theta);
+
+        m_zetaN = zetaN;
+        m_alpha = 1 / (1 - theta);
+        m_eta = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetaN);
+    }
+
+    uint64_t operator()(uint64_t &state) const
+    {
+        auto u = (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+        auto uz = u * m_zetaN;
+        if (uz < 1)
+        {
+            return 0;
+        }
+        if (uz < 1 + std::pow(0.5, m_theta))
+        {
+            return 1 % m_n;
+        }
+        auto index = (uint64_t)(m_n * std::pow(m_eta * u - m_eta + 1, m_alpha));
+        return index < m_n ? index : m_n - 1;
+    }
+
+private:
+    uint64_t m_n;
+    double m_theta;
+    double m_zetaN;
+    double m_alpha;
+    double m_eta;
+};
+
+// 作为对比的B+树：叶节点双向链接，内部节点记录各子树的键个数以支持排名查询。
+// 删除采用free-at-empty策略，节点只在变空时释放，不做借键与合并，
+// 插入删除混合时的空间利用率与合并策略相近，实现简单得多
+template <typename K, int Fanout = 64>
+class BenchBTree
+{
+public:
+    BenchBTree() { m_root = new Leaf; }
+    ~BenchBTree() { destroy(m_root); }
+
+    BenchBTree(const BenchBTree &) = delete;
+    BenchBTree &operator=(const BenchBTree &) = delete;
+
+    bool insert(const K &key)
+    {
+        Split split;
+        if (!insertInto(m_root, key, split))
+        {
+            return false;
+        }
+
+        if (split.m_node)
+        {
+            auto root = new Inner;
+            root->m_count = 2;
+            root->m_keyArray[0] = split.m_key;
+            root->m_childArray[0] = m_root;
+            root->m_childArray[1] = split.m_node;
+            root->m_sizeArray[0] = sizeOf(m_root);
+            root->m_sizeArray[1] = sizeOf(split.m_node);
+            m_root = root;
+        }
+        return true;
+    }
+
+    bool remove(const K &key)
+    {
+        if (!removeFrom(m_root, key))
+        {
+            return false;
+        }
+
+        // 根节点只剩一个子节点时降低树高，全部删除后换回空的叶节点
+        while (!m_root->m_leaf && m_root->m_count <= 1)
+        {
+            auto root = static_cast<Inner *>(m_root);
+            m_root = root->m_count ? root->m_childArray[0] : new Leaf;
+            delete root;
+        }
+        return true;
+    }
+
+    bool find(const K &key) const
+    {
+        auto leaf = findLeaf(key, nullptr);
+        return std::binary_search(leaf->m_keyArray, leaf->m_keyArray + leaf->m_count, key);
+    }
+
+    // 从第一个不小于key的键开始按顺序对最多count个键调用func
+    template <typename F>
+    void scan(const K &key, int count, F &&func) const
+    {
+        auto leaf = findLeaf(key, nullptr);
+        auto index = (int)(std::lower_bound(leaf->m_keyArray, leaf->m_keyArray + leaf->m_count, key) - leaf->m_keyArray);
+        while (leaf && count > 0)
+        {
+            for (; index < leaf->m_count && count > 0; ++index, --count)
+            {
+                func(leaf->m_keyArray[index]);
+            }
+            leaf = leaf->m_next;
+            index = 0;
+        }
+    }
+
+    // key的排名(从0开始)，不存在时返回-1
+    long rank(const K &key) const
+    {
+        unsigned long rank = 0;
+        auto leaf = findLeaf(key, &rank);
+        auto pos = std::lower_bound(leaf->m_keyArray, leaf->m_keyArray + leaf->m_count, key);
+        if (pos == leaf->m_keyArray + leaf->m_count || key < *pos)
+        {
+            return -1;
+        }
+        return (long)(rank + (pos - leaf->m_keyArray));
+    }
+
+private:
+    struct Node
+    {
+        explicit Node(bool leaf) : m_leaf{leaf} {}
+
+        bool m_leaf;
+        // 叶节点的键个数，或内部节点的子节点个数
+        int m_count = 0;
+    };
+
+    // 键数组多留一个位置，先插入再分裂
+    struct Leaf : Node
+    {
+        Leaf() : Node{true} {}
+
+        K m_keyArray[Fanout + 1];
+        Leaf *m_prev = nullptr;
+        Leaf *m_next = nullptr;
+    };
+
+    // 子节点i中的键在[m_keyArray[i - 1], m_keyArray[i])内，m_sizeArray[i]为其中的键个数
+    struct Inner : Node
+    {
+        Inner() : Node{false} {}
+
+        K m_keyArray[Fanout];
+        Node *m_childArray[Fanout + 1];
+        unsigned long m_sizeArray[Fanout + 1];
+    };
+
+    // 分裂出的右侧节点及其最小键
+    struct Split
+    {
+        K m_key{};
+        Node *m_node = nullptr;
+    };
+
+    static int childIndex(const Inner *inner, const K &key)
+    {
+        return (int)(std::upper_bound(inner->m_keyArray, inner->m_keyArray + inner->m_count - 1, key) - inner->m_keyArray);
+    }
+
+    static unsigned long sizeOf(const Node *node)
+    {
+        if (node->m_leaf)
+        {
+            return node->m_count;
+        }
+        auto inner = static_cast<const Inner *>(node);
+        unsigned long size = 0;
+        for (int i = 0; i < inner->m_count; ++i)
+        {
+            size += inner->m_sizeArray[i];
+        }
+        return size;
+    }
+
+    static void destroy(Node *node)
+    {
+        if (node->m_leaf)
+        {
+            delete static_cast<Leaf *>(node);
+            return;
+        }
+        auto inner = static_cast<Inner *>(node);
+        for (int i = 0; i < inner->m_count; ++i)
+        {
+            destroy(inner->m_childArray[i]);
+        }
+        delete inner;
+    }
+
+    // 找到key所在的叶节点，rank不为nullptr时累加左侧子树的键个数
+    const Leaf *findLeaf(const K &key, unsigned long *rank) const
+    {
+        auto node = m_root;
+        while (!node->m_leaf)
+        {
+            auto inner = static_cast<const Inner *>(node);
+            auto index = childIndex(inner, key);
+            if (rank)
+            {
+                for (int i = 0; i < index; ++i)
+                {
+                    *rank += inner->m_sizeArray[i];
+                }
+            }
+            node = inner->m_childArray[index];
+        }
+        return static_cast<const Leaf *>(node);
+    }
+
+    bool insertInto(Node *node, const K &key, Split &split)
+    {
+        if (node->m_leaf)
+        {
+            auto leaf = static_cast<Leaf *>(node);
+            auto end = leaf->m_keyArray + leaf->m_count;
+            auto pos = std::lower_bound(leaf->m_keyArray, end, key);
+            if (pos != end && !(key < *pos))
+            {
+                return false;
+            }
+            std::copy_backward(pos, end, end + 1);
+            *pos = key;
+            if (++leaf->m_count <= Fanout)
+            {
+                return true;
+            }
+
+            auto right = new Leaf;
+            auto half = leaf->m_count / 2;
+            right->m_count = leaf->m_count - half;
+            std::copy(leaf->m_keyArray + half, leaf->m_keyArray + leaf->m_count, right->m_keyArray);
+            leaf->m_count = half;
+
+            right->m_prev = leaf;
+            right->m_next = leaf->m_next;
+            if (leaf->m_next)
+            {
+                leaf->m_next->m_prev = right;
+            }
+            leaf->m_next = right;
+
+            split.m_key = right->m_keyArray[0];
+            split.m_node = right;
+            return true;
+        }
+
+        auto inner = static_cast<Inner *>(node);
+        auto index = childIndex(inner, key);
+        Split childSplit;
+        if (!insertInto(inner->m_childArray[index], key, childSplit))
+        {
+            return false;
+        }
+        ++inner->m_sizeArray[index];
+        if (!childSplit.m_node)
+        {
+            return true;
+        }
+
+        // 分裂出的节点作为第index + 1个子节点
+        auto count = inner->m_count;
+        std::copy_backward(inner->m_keyArray + index, inner->m_keyArray + count - 1, inner->m_keyArray + count);
+        std::copy_backward(inner->m_childArray + index + 1, inner->m_childArray + count, inner->m_childArray + count + 1);
+        std::copy_backward(inner->m_sizeArray + index + 1, inner->m_sizeArray + count, inner->m_sizeArray + count + 1);
+        inner->m_keyArray[index] = childSplit.m_key;
+        inner->m_childArray[index + 1] = childSplit.m_node;
+        inner->m_sizeArray[index + 1] = sizeOf(childSplit.m_node);
+        inner->m_sizeArray[index] -= inner->m_sizeArray[index + 1];
+        if (++inner->m_count <= Fanout)
+        {
+            return true;
+        }
+
+        // 左侧保留前half个子节点，第half - 1个分隔键提升到上一层
+        count = inner->m_count;
+        auto half = count / 2;
+        auto right = new Inner;
+        right->m_count = count - half;
+        std::copy(inner->m_childArray + half, inner->m_childArray + count, right->m_childArray);
+        std::copy(inner->m_sizeArray + half, inner->m_sizeArray + count, right->m_sizeArray);
+        std::copy(inner->m_keyArray + half, inner->m_keyArray + count - 1, right->m_keyArray);
+        inner->m_count = half;
+
+        split.m_key = inner->m_keyArray[half - 1];
+        split.m_node = right;
+        return true;
+    }
+
+    bool removeFrom(Node *node, const K &key)
+    {
+        if (node->m_leaf)
+        {
+            auto leaf = static_cast<Leaf *>(node);
+            auto end = leaf->m_keyArray + leaf->m_count;
+            auto pos = std::lower_bound(leaf->m_keyArray, end, key);
+            if (pos == end || key < *pos)
+            {
+                return false;
+            }
+            std::copy(pos + 1, end, pos);
+            --leaf->m_count;
+            return true;
+        }
+
+        auto inner = static_cast<Inner *>(node);
+        auto index = childIndex(inner, key);
+        auto child = inner->m_childArray[index];
+        if (!removeFrom(child, key))
+        {
+            return false;
+        }
+        --inner->m_sizeArray[index];
+        if (child->m_count)
+        {
+            return true;
+        }
+
+        // 释放变空的子节点，相邻子节点的区间合并，去掉它们之间的一个分隔键
+        if (child->m_leaf)
+        {
+            auto leaf = static_cast<Leaf *>(child);
+            if (leaf->m_prev)
+            {
+                leaf->m_prev->m_next = leaf->m_next;
+            }
+            if (leaf->m_next)
+            {
+                leaf->m_next->m_prev = leaf->m_prev;
+            }
+        }
+        destroy(child);
+
+        auto count = inner->m_count;
+        if (count > 1)
+        {
+            auto keyIndex = index > 0 ? index - 1 : 0;
+            std::copy(inner->m_keyArray + keyIndex + 1, inner->m_keyArray + count - 1, inner->m_keyArray + keyIndex);
+        }
+        std::copy(inner->m_childArray + index + 1, inner->m_childArray + count, inner->m_childArray + index);
+        std::copy(inner->m_sizeArray + index + 1, inner->m_sizeArray + count, inner->m_sizeArray + index);
+        --inner->m_count;
+        return true;
+    }
+
+    Node *m_root;
+};
+
+// 各容器统一的操作接口：键为非0的正整数，scan从第一个不小于key的键开始读取count个键并返回它们的和(按无符号数回绕)
+#if SKIPLIST_BENCH == 1
+// SkipList1按{score, data}排序，键作为score，data都为nullptr；没有单独的查找，用getRank代替
+class SkipListAdapter
+{
+public:
+    const static bool HAS_RANK = true;
+    static const char *name() { return "skiplist1"; }
+
+    bool insert(long long key) { return m_skipList.insert(key, nullptr); }
+    bool remove(long long key) { return m_skipList.remove(key, nullptr); }
+    bool find(long long key) { return m_skipList.getRank(key, nullptr) >= 0; }
+    unsigned long long scan(long long key, int count)
+    {
+        m_skipList.rangeByScore({key, LLONG_MAX}, m_result, 0, count);
+        unsigned long long sum = 0;
+        for (auto &node : m_result)
+        {
+            sum += node.first;
+        }
+        return sum;
+    }
+    long rank(long long key) { return m_skipList.getRank(key, nullptr); }
+
+private:
+    SkipList m_skipList;
+    std::vector<std::pair<long long, void *>> m_result;
+};
+#elif SKIPLIST_BENCH == 2
+// SkipList2保存数据指针，键直接作为指针的值，用默认的按地址比较；
+// 没有按值的范围查询，scan的起点必须存在，先取排名再按排名读取
+class SkipListAdapter
+{
+public:
+    const static bool HAS_RANK = true;
+    static const char *name() { return "skiplist2"; }
+
+    bool insert(long long key) { return m_skipList.insert(toData(key)); }
+    bool remove(long long key) { return m_skipList.remove(toData(key)); }
+    bool find(long long key) { return m_skipList.find(toData(key)) != nullptr; }
+    unsigned long long scan(long long key, int count)
+    {
+        auto rank = m_skipList.getRank(toData(key));
+        if (rank < 0)
+        {
+            return 0;
+        }
+        m_skipList.rangeByRank(rank, rank + count - 1, m_result);
+        unsigned long long sum = 0;
+        for (auto data : m_result)
+        {
+            sum += (uintptr_t)data;
+        }
+        return sum;
+    }
+    long rank(long long key) { return m_skipList.getRank(toData(key)); }
+
+private:
+    static const void *toData(long long key) { return (const void *)(uintptr_t)key; }
+
+    SkipList m_skipList;
+    std::vector<const void *> m_result;
+};
+#else
+// LevelGen为SkipListDeterministicLevelGen时是确定性平衡的1-2-3跳表，与随机层高对比延迟分位数
+template <class LevelGen>
+class SkipList3Adapter
+{
+public:
+    const static bool HAS_RANK = true;
+    static const char *name() { return std::is_same<LevelGen, SkipListDeterministicLevelGen<>>::value ? "skiplist3d" : "skiplist3"; }
+
+    bool insert(long long key) { return m_skipList.insert(key); }
+    bool remove(long long key) { return m_skipList.remove(key); }
+    bool find(long long key) { return m_skipList.find(key) != nullptr; }
+    unsigned long long scan(long long key, int count)
+    {
+        unsigned long long sum = 0;
+        for (auto it = m_skipList.lower_bound(key); it != m_skipList.end() && count > 0; ++it, --count)
+        {
+            sum += *it;
+        }
+        return sum;
+    }
+    long rank(long long key) { return m_skipList.getRank(key); }
+
+private:
+    SkipList<long long, std::less<long long>, SkipListPoolAllocator, LevelGen> m_skipList;
+};
+
+using SkipListAdapter = SkipList3Adapter<SkipListLevelGen<>>;
+using SkipListDetAdapter = SkipList3Adapter<SkipListDeterministicLevelGen<>>;
+#endif
+
+// std::set/std::map求排名需要O(n)的std::distance，不参加排名负载
+class SetAdapter
+{
+public:
+    const static bool HAS_RANK = false;
+    static const char *name() { return "set"; }
+
+    bool insert(long long key) { return m_set.insert(key).second; }
+    bool remove(long long key) { return m_set.erase(key) > 0; }
+    bool find(long long key) { return m_set.find(key) != m_set.end(); }
+    unsigned long long scan(long long key, int count)
+    {
+        unsigned long long sum = 0;
+        for (auto it = m_set.lower_bound(key); it != m_set.end() && count > 0; ++it, --count)
+        {
+            sum += *it;
+        }
+        return sum;
+    }
+    long rank(long long) { return -1; }
+
+private:
+    std::set<long long> m_set;
+};
+
+class MapAdapter
+{
+public:
+    const static bool HAS_RANK = false;
+    static const char *name() { return "map"; }
+
+    bool insert(long long key) { return m_map.emplace(key, key).second; }
+    bool remove(long long key) { return m_map.erase(key) > 0; }
+    bool find(long long key) { return m_map.find(key) != m_map.end(); }
+    unsigned long long scan(long long key, int count)
+    {
+        unsigned long long sum = 0;
+        for (auto it = m_map.lower_bound(key); it != m_map.end() && count > 0; ++it, --count)
+        {
+            sum += it->second;
+        }
+        return sum;
+    }
+    long rank(long long) { return -1; }
+
+private:
+    std::map<long long, long long> m_map;
+};
+
+class BTreeAdapter
+{
+public:
+    const static bool HAS_RANK = true;
+    static const char *name() { return "btree"; }
+
+    bool insert(long long key) { return m_tree.insert(key); }
+    bool remove(long long key) { return m_tree.remove(key); }
+    bool find(long long key) { return m_tree.find(key); }
+    unsigned long long scan(long long key, int count)
+    {
+        unsigned long long sum = 0;
+        m_tree.scan(key, count, [&](long long data)
+                    { sum += data; });
+        return sum;
+    }
+    long rank(long long key) { return m_tree.rank(key); }
+
+private:
+    BenchBTree<long long> m_tree;
+};
+
+// perf_event的cache miss计数器，只统计用户态
+class CacheMissCounter
+{
+public:
+    CacheMissCounter()
+    {
+#ifdef __linux__
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+    ~CacheMissCounter()
+    {
+#ifdef __linux__
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+        }
+#endif
+    }
+
+    CacheMissCounter(const CacheMissCounter &) = delete;
+    CacheMissCounter &operator=(const CacheMissCounter &) = delete;
+
+    bool available() const { return m_fd >= 0; }
+
+    void start()
+    {
+#ifdef __linux__
+        if (m_fd >= 0)
+        {
+            ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    // 停止计数并返回start以来的cache miss数，不可用时返回0
+    unsigned long long stop()
+    {
+        unsigned long long count = 0;
+#ifdef __linux__
+        if (m_fd >= 0)
+        {
+            ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(m_fd, &count, sizeof(count)) != (ssize_t)sizeof(count))
+            {
+                count = 0;
+            }
+        }
+#endif
+        return count;
+    }
+
+private:
+    int m_fd = -1;
+};
+
+// 本进程的峰值RSS(KB)，不支持时返回0
+static unsigned long long peakRss()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// 访问模式：按键的顺序、均匀随机、Zipf分布
+enum AccessType
+{
+    ACCESS_SEQUENTIAL,
+    ACCESS_UNIFORM,
+    ACCESS_ZIPF,
+};
+
+// 操作类型：查找、范围扫描、排名、查找与更新(删除一个键再插入一个新键，数据量不变)的混合
+enum OpType
+{
+    OP_FIND,
+    OP_SCAN,
+    OP_RANK,
+    OP_MIX,
+};
+
+struct Workload
+{
+    const char *m_name;
+    OpType m_opType;
+    AccessType m_accessType;
+    // OP_MIX中查找所占的百分比
+    int m_readPercent;
+};
+
+// 加载之后按顺序运行的负载，更新类的负载放在最后
+const static Workload s_workloadArray[] = {
+    {"read-seq", OP_FIND, ACCESS_SEQUENTIAL, 100},
+    {"read-uniform", OP_FIND, ACCESS_UNIFORM, 100},
+    {"read-zipf", OP_FIND, ACCESS_ZIPF, 100},
+    {"scan-100", OP_SCAN, ACCESS_UNIFORM, 100},
+    {"rank", OP_RANK, ACCESS_UNIFORM, 100},
+    {"rw-95/5", OP_MIX, ACCESS_ZIPF, 95},
+    {"rw-50/50", OP_MIX, ACCESS_UNIFORM, 50},
+};
+
+// 一次运行的参数与数据
+struct BenchContext
+{
+    unsigned long m_size = 0;
+    const char *m_dataset = nullptr;
+    bool m_sequential = false;
+    unsigned long m_opCount = 0;
+    uint64_t m_seed = 0;
+    const ZipfGen *m_zipf = nullptr;
+    // 当前容器中的键，更新负载用新键替换被删除的键
+    std::vector<long long> m_keyArray;
+    // 顺序数据集中下一个新键
+    long long m_nextKey = 0;
+};
+
+// 运行count个操作并输出一行结果：op(i)执行第i个操作并返回用于check的值
+template <typename Op>
+static void measure(const char *container, const BenchContext &context, const char *workload, unsigned long count,
+                    CacheMissCounter &cacheMiss, unsigned long long baseRss, Op &&op)
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<double> latencyArray;
+    latencyArray.reserve(count / STRIDE + 1);
+    unsigned long long check = 0;
+
+    cacheMiss.start();
+    auto begin = Clock::now();
+    for (unsigned long i = 0; i < count; ++i)
+    {
+        if (i % STRIDE)
+        {
+            check += op(i);
+            continue;
+        }
+
+        auto opBegin = Clock::now();
+        check += op(i);
+        latencyArray.push_back(std::chrono::duration<double, std::nano>(Clock::now() - opBegin).count());
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - begin;
+    auto missCount = cacheMiss.stop();
+    s_sink = s_sink + (long long)check;
+
+    std::sort(latencyArray.begin(), latencyArray.end());
+    auto percentile = [&](double p)
+    { return latencyArray.empty() ? 0 : latencyArray[(size_t)(p * (latencyArray.size() - 1))]; };
+
+    char missText[32] = "-";
+    if (cacheMiss.available())
+    {
+        snprintf(missText, sizeof(missText), "%.2f", (double)missCount / count);
+    }
+    char memText[32] = "-";
+    if (baseRss)
+    {
+        snprintf(memText, sizeof(memText), "%.1f", (peakRss() - baseRss) / 1024.0);
+    }
+
+    printf("%10lu %-10s %-10s %-12s %9.3f %8.0f %8.0f %8.0f %8s %9s %08llx\n", context.m_size, context.m_dataset, container, workload,
+           count / elapsed.count() / 1e6, percentile(0.5), percentile(0.99), percentile(0.999), missText, memText, check & 0xffffffffull);
+    fflush(stdout);
+}
+
+// 在一个容器上加载数据并依次运行全部负载
+template <class Adapter>
+static void runContainer(BenchContext &context)
+{
+    Adapter adapter;
+    CacheMissCounter cacheMiss;
+    auto baseRss = peakRss();
+    auto &keyArray = context.m_keyArray;
+    auto size = context.m_size;
+
+    measure(Adapter::name(), context, "load", size, cacheMiss, baseRss, [&](unsigned long i)
+            { return (unsigned long long)adapter.insert(keyArray[i]); });
+
+    for (size_t w = 0; w < sizeof(s_workloadArray) / sizeof(s_workloadArray[0]); ++w)
+    {
+        auto &workload = s_workloadArray[w];
+        if (workload.m_opType == OP_RANK && !Adapter::HAS_RANK)
+        {
+            continue;
+        }
+
+        // 各负载的随机数序列只由种子和负载决定，与容器无关
+        uint64_t state = mix64(context.m_seed ^ (w + 1)) | 1;
+        // 按键的顺序访问时使用排序后的副本
+        std::vector<long long> sortedArray;
+        if (workload.m_accessType == ACCESS_SEQUENTIAL)
+        {
+            sortedArray = keyArray;
+            std::sort(sortedArray.begin(), sortedArray.end());
+        }
+
+        auto pickIndex = [&](unsigned long i) -> size_t
+        {
+            switch (workload.m_accessType)
+            {
+            case ACCESS_SEQUENTIAL:
+                return i % size;
+            case ACCESS_UNIFORM:
+                return nextRandom(state) % size;
+            default:
+                // 热点序号打散到整个数组，避免顺序数据集的热点都集中在最小的键
+                return mix64((*context.m_zipf)(state)) % size;
+            }
+        };
+
+        auto count = workload.m_opType == OP_SCAN ? context.m_opCount / 10 : context.m_opCount;
+        measure(Adapter::name(), context, workload.m_name, count, cacheMiss, baseRss, [&](unsigned long i) -> unsigned long long
+                {
+            auto index = pickIndex(i);
+            auto key = workload.m_accessType == ACCESS_SEQUENTIAL ? sortedArray[index] : keyArray[index];
+            switch (workload.m_opType)
+            {
+            case OP_FIND:
+                return adapter.find(key);
+            case OP_SCAN:
+                return adapter.scan(key, SCAN_LENGTH);
+            case OP_RANK:
+                return (unsigned long long)adapter.rank(key);
+            default:
+                break;
+            }
+
+            if ((int)(nextRandom(state) % 100) < workload.m_readPercent)
+            {
+                return adapter.find(key);
+            }
+            auto newKey = context.m_sequential ? context.m_nextKey++ : randomKey(state);
+            auto removed = adapter.remove(key);
+            auto inserted = adapter.insert(newKey);
+            keyArray[index] = newKey;
+            return removed * 2 + inserted; });
+    }
+}
+
+// 在子进程中运行func，子进程对键数组的修改不影响后续的运行，峰值RSS也互不影响；
+// 不支持fork时在本进程中运行，之后恢复键数组
+template <typename F>
+static void runIsolated(BenchContext &context, F &&func)
+{
+#ifndef _WIN32
+    fflush(stdout);
+    auto pid = fork();
+    if (pid == 0)
+    {
+        func();
+        fflush(stdout);
+        _exit(0);
+    }
+    if (pid > 0)
+    {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        return;
+    }
+#endif
+    auto keyArray = context.m_keyArray;
+    auto nextKey = context.m_nextKey;
+    func();
+    context.m_keyArray = std::move(keyArray);
+    context.m_nextKey = nextKey;
+}
+
+// 解析以逗号分隔的列表
+static std::vector<std::string> splitList(const char *text)
+{
+    std::vector<std::string> result;
+    std::string item;
+    for (auto p = text;; ++p)
+    {
+        if (*p == ',' || *p == '\0')
+        {
+            if (!item.empty())
+            {
+                result.push_back(item);
+            }
+            item.clear();
+            if (*p == '\0')
+            {
+                break;
+            }
+        }
+        else
+        {
+            item.push_back(*p);
+        }
+    }
+    return result;
+}
+
+static bool contains(const std::vector<std::string> &array, const char *name)
+{
+    return std::find(array.begin(), array.end(), name) != array.end();
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<unsigned long> sizeArray{1000, 100000, 1000000};
+    unsigned long opCount = 1000000;
+#if SKIPLIST_BENCH == 3
+    std::vector<std::string> containerArray{"skiplist", "skiplist-det", "set", "map", "btree"};
+#else
+    std::vector<std::string> containerArray{"skiplist", "set", "map", "btree"};
+#endif
+    std::vector<std::string> datasetArray{"random", "sequential"};
+    uint64_t seed = 1;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (!strcmp(argv[i], "-n"))
+        {
+            sizeArray.clear();
+            for (auto &size : splitList(argv[i + 1]))
+            {
+                sizeArray.push_back(strtoul(size.c_str(), nullptr, 10));
+            }
+        }
+        else if (!strcmp(argv[i], "-o"))
+        {
+            opCount = strtoul(argv[i + 1], nullptr, 10);
+        }
+        else if (!strcmp(argv[i], "-c"))
+        {
+            containerArray = splitList(argv[i + 1]);
+        }
+        else if (!strcmp(argv[i], "-d"))
+        {
+            datasetArray = splitList(argv[i + 1]);
+        }
+        else if (!strcmp(argv[i], "-s"))
+        {
+            seed = strtoull(argv[i + 1], nullptr, 10);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [-n sizes] [-o ops] [-c skiplist,skiplist-det,set,map,btree] [-d random,sequential] [-s seed]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    printf("%10s %-10s %-10s %-12s %9s %8s %8s %8s %8s %9s %8s\n", "size", "dataset", "container", "workload",
+           "Mops/s", "p50 ns", "p99 ns", "p99.9 ns", "miss/op", "mem MB", "check");
+
+    for (auto size : sizeArray)
+    {
+        if (!size)
+        {
+            continue;
+        }
+        ZipfGen zipf{size};
+
+        for (auto &dataset : datasetArray)
+        {
+            BenchContext context;
+            context.m_size = size;
+            context.m_dataset = dataset.c_str();
+            context.m_sequential = dataset == "sequential";
+            context.m_opCount = opCount;
+            context.m_seed = seed;
+            context.m_zipf = &zipf;
+
+            context.m_keyArray.resize(size);
+            uint64_t state = mix64(seed) | 1;
+            for (unsigned long i = 0; i < size; ++i)
+            {
+                context.m_keyArray[i] = context.m_sequential ? (long long)i + 1 : randomKey(state);
+            }
+            context.m_nextKey = (long long)size + 1;
+
+            if (contains(containerArray, "skiplist"))
+            {
+                runIsolated(context, [&]()
+                            { runContainer<SkipListAdapter>(context); });
+            }
+#if SKIPLIST_BENCH == 3
+            if (contains(containerArray, "skiplist-det"))
+            {
+                runIsolated(context, [&]()
+                            { runContainer<SkipListDetAdapter>(context); });
+            }
+#endif
+            if (contains(containerArray, "set"))
+            {
+                runIsolated(context, [&]()
+                            { runContainer<SetAdapter>(context); });
+            }
+            if (contains(containerArray, "map"))
+            {
+                runIsolated(context, [&]()
+                            { runContainer<MapAdapter>(context); });
+            }
+            if (contains(containerArray, "btree"))
+            {
+                runIsolated(context, [&]()
+                            { runContainer<BTreeAdapter>(context); });
+            }
+        }
+    }
+
+    return 0;
+}
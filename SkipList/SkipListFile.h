@@ -0,0 +1,84 @@
+#ifndef _SKIPLIST_FILE_H_
+#define _SKIPLIST_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+// 快照和操作日志共用的文件工具
+
+// 校验和：按8字节为单位乘法散列，
+// 可以分段计算，上一段的结果作为下一段的hash，除最后一段外每段长度须为8的倍数
+inline uint64_t skipListChecksum(uint64_t hash, const unsigned char *data, size_t size)
+{
+    const uint64_t PRIME = 0x9e3779b97f4a7c15ull;
+    for (; size >= sizeof(uint64_t); data += sizeof(uint64_t), size -= sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, data, sizeof word);
+        hash = (hash ^ word) * PRIME;
+        hash ^= hash >> 29;
+    }
+    if (size)
+    {
+        uint64_t word = 0;
+        memcpy(&word, data, size);
+        hash = (hash ^ word ^ ((uint64_t)size << 56)) * PRIME;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+// 将文件缓冲区写入并刷到磁盘
+inline bool skipListSyncFile(FILE *file)
+{
+    if (fflush(file) != 0)
+    {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+// 用from替换to，POSIX下rename本身是原子的
+inline bool skipListReplaceFile(const char *from, const char *to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+// 将文件截断到size字节
+inline bool skipListTruncateFile(const char *path, uint64_t size)
+{
+#ifdef _WIN32
+    int fd;
+    if (_sopen_s(&fd, path, _O_RDWR | _O_BINARY, _SH_DENYNO, _S_IREAD | _S_IWRITE) != 0)
+    {
+        return false;
+    }
+    auto ok = _chsize_s(fd, (__int64)size) == 0;
+    _close(fd);
+    return ok;
+#else
+    return truncate(path, (off_t)size) == 0;
+#endif
+}
+
+#endif
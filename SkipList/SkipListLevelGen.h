@@ -0,0 +1,151 @@
+#ifndef _SKIPLIST_LEVEL_GEN_H_
+#define _SKIPLIST_LEVEL_GEN_H_
+
+#include <atomic>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// 层高生成策略：
+// 层高上限MaxLevel和升高1层的概率1/Branching在编译期确定，Branching必须是2的幂。
+// 每次只取一个64位随机数，末尾连续的0的个数除以log2(Branching)即为额外升高的层数。
+// seed为0时使用线程局部的随机数发生器，可以被多个线程同时使用；
+// 否则使用本对象独立的发生器，相同的seed生成相同的层高序列，但不能被多个线程同时使用。
+template <unsigned char MaxLevel = 32, unsigned int Branching = 4>
+class SkipListLevelGen
+{
+public:
+    static_assert(MaxLevel > 0, "MaxLevel must be positive");
+    static_assert(Branching >= 2 && (Branching & (Branching - 1)) == 0, "Branching must be a power of 2");
+
+    // 层高上限
+    const static unsigned char MAX_LEVEL = MaxLevel;
+    // 每Branching个节点中期望有1个升高1层
+    const static unsigned int BRANCHING = Branching;
+
+    explicit SkipListLevelGen(uint64_t seed = 0) { this->seed(seed); }
+
+    // 重新设置种子，0表示使用线程局部的发生器
+    void seed(uint64_t seed) { m_state = seed ? mix(seed) | 1 : 0; }
+
+    // 生成节点层高
+    unsigned char operator()()
+    {
+        auto random = m_state ? next(m_state) : threadLocalNext();
+        if (!random)
+        {
+            return MAX_LEVEL;
+        }
+
+        auto level = 1 + countTrailingZeros(random) / BITS_PER_LEVEL;
+        return level < MAX_LEVEL ? level : MAX_LEVEL;
+    }
+
+    // 按排名(从1开始)生成确定的层高，每BRANCHING个节点升高1层
+    static unsigned char rankLevel(unsigned long rank)
+    {
+        unsigned char level = 1;
+        while (level < MAX_LEVEL && rank % BRANCHING == 0)
+        {
+            rank /= BRANCHING;
+            ++level;
+        }
+        return level;
+    }
+
+private:
+    // 每升高1层消耗的随机位数
+    const static unsigned int BITS_PER_LEVEL = Branching == 2 ? 1 : Branching == 4 ? 2 : Branching == 8 ? 3 : Branching == 16 ? 4 : Branching == 32 ? 5 : 6;
+
+    // splitmix64的混合函数，把任意种子打散为发生器的初始状态
+    static uint64_t mix(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ull;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    // xorshift64*，乘法只会打散高位，因此把质量更好的高32位交换到低位再统计末尾的0
+    static uint64_t next(uint64_t &state)
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        auto random = state * 0x2545f4914f6cdd1dull;
+        return (random >> 32) | (random << 32);
+    }
+
+    static uint64_t threadLocalNext()
+    {
+        // 首次使用时按线程的启用顺序取种子
+        static std::atomic<uint64_t> s_seed{0};
+        thread_local uint64_t s_state = 0;
+        if (!s_state)
+        {
+            s_state = mix(s_seed.fetch_add(1, std::memory_order_relaxed)) | 1;
+        }
+        return next(s_state);
+    }
+
+    static unsigned int countTrailingZeros(uint64_t x)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, x);
+        return index;
+#else
+        return __builtin_ctzll(x);
+#endif
+    }
+
+    // 本对象独立的发生器状态，0表示使用线程局部的发生器
+    uint64_t m_state = 0;
+};
+
+// 确定性层高策略，配合SkipList3的1-2-3平衡模式使用：
+// 新节点的层高总为1，插入/删除时由跳表提升或降低节点层高，
+// 使相邻两个高于h层的节点之间总有1~3个层高恰为h的节点，查找在每层最多前进4步
+template <unsigned char MaxLevel = 32>
+class SkipListDeterministicLevelGen
+{
+public:
+    static_assert(MaxLevel > 1, "MaxLevel must be greater than 1");
+
+    // 层高上限
+    const static unsigned char MAX_LEVEL = MaxLevel;
+    // 由跳表维持层高
+    const static bool DETERMINISTIC = true;
+
+    unsigned char operator()() { return 1; }
+
+    // 按排名(从1开始)生成层高：末尾连续的0的个数加1，每两个节点升高1层
+    static unsigned char rankLevel(unsigned long rank)
+    {
+        unsigned char level = 1;
+        while (level < MAX_LEVEL && rank % 2 == 0)
+        {
+            rank /= 2;
+            ++level;
+        }
+        return level;
+    }
+
+    // 总数为count时排名为index(从0开始)的节点的层高：
+    // 每层把奇数位置的节点提升一层，但不提升该层最后一个节点，保证末尾的间隔不空；该层不超过3个节点时停止
+    static unsigned char balancedLevel(unsigned long index, unsigned long count)
+    {
+        unsigned char level = 1;
+        while (level < MAX_LEVEL && count > 3 && index % 2 == 1 && index < count - 1)
+        {
+            index = (index - 1) / 2;
+            count = (count - 1) / 2;
+            ++level;
+        }
+        return level;
+    }
+};
+
+#endif // _SKIPLIST_LEVEL_GEN_H_
@@ -0,0 +1,372 @@
+#include <chrono>
+#include "SkipListFile.h"
+#include "SkipListOpLog.h"
+
+// 日志文件头，之后是若干帧，每帧为FRAME_HEADER_SIZE字节的帧头和若干条记录
+struct OpLogHeader
+{
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_reserved;
+    // 日志段的序号；基准文件中为它之后第一个日志段的序号
+    uint64_t m_seq;
+};
+
+static const char OP_LOG_MAGIC[8] = {'S', 'K', 'L', 'O', 'P', 'L', 'O', 'G'};
+static const uint32_t OP_LOG_VERSION = 1;
+
+SkipListOpLog::SkipListOpLog(std::string path, SyncPolicy syncPolicy, uint64_t compactThreshold)
+    : m_path{std::move(path)}, m_syncPolicy{syncPolicy}, m_compactThreshold{compactThreshold}, m_compactSize{compactThreshold}
+{
+    m_buffer.reserve(BATCH_SIZE * 2);
+}
+
+SkipListOpLog::~SkipListOpLog()
+{
+    close();
+}
+
+bool SkipListOpLog::open(ReplayFunc replayFunc, void *context)
+{
+    if (m_file)
+    {
+        return false;
+    }
+
+    // 没有基准文件时从0号日志段开始
+    uint64_t size;
+    if (!replayFile(basePath(), &m_baseSeq, false, &size, replayFunc, context))
+    {
+        m_baseSeq = 0;
+    }
+
+    // 删除压缩时没来得及删除的旧日志段，它们的序号连续且紧挨着m_baseSeq
+    for (auto seq = m_baseSeq; seq > 0 && std::remove(segmentPath(seq - 1).c_str()) == 0; --seq)
+    {
+    }
+
+    // 按序号重放日志段，崩溃时可能留下一个刚创建、文件头还不完整的日志段，之后会被覆盖
+    auto seq = m_baseSeq;
+    while (replayFile(segmentPath(seq), &seq, true, &size, replayFunc, context))
+    {
+        ++seq;
+    }
+
+    if (seq > m_baseSeq)
+    {
+        m_seq = seq - 1;
+        m_file = fopen(segmentPath(m_seq).c_str(), "ab");
+    }
+    else
+    {
+        m_seq = seq;
+        m_file = createFile(segmentPath(m_seq), m_seq);
+        size = sizeof(OpLogHeader);
+    }
+    if (!m_file)
+    {
+        return false;
+    }
+
+    m_buffer.clear();
+    m_failed = false;
+    m_segmentSize.store(size, std::memory_order_relaxed);
+    m_compactSize.store(m_compactThreshold, std::memory_order_relaxed);
+
+    if (m_syncPolicy == SyncPolicy::EVERY_SECOND)
+    {
+        m_stopping = false;
+        m_syncThread = std::thread(&SkipListOpLog::syncLoop, this);
+    }
+
+    return true;
+}
+
+bool SkipListOpLog::close()
+{
+    if (m_syncThread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_syncCond.notify_all();
+        m_syncThread.join();
+    }
+
+    waitCompaction();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file)
+    {
+        return true;
+    }
+
+    auto ok = writeBatch() && skipListSyncFile(m_file);
+    ok = fclose(m_file) == 0 && ok;
+    m_file = nullptr;
+
+    return ok;
+}
+
+void SkipListOpLog::append(OpType type, long long score, std::string_view bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    encodeRecord(m_buffer, type, score, bytes);
+    if (m_buffer.size() >= BATCH_SIZE)
+    {
+        writeBatch();
+    }
+}
+
+bool SkipListOpLog::flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return writeBatch();
+}
+
+bool SkipListOpLog::sync()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!writeBatch() || !skipListSyncFile(m_file))
+    {
+        m_failed = true;
+    }
+    return !m_failed;
+}
+
+bool SkipListOpLog::compact(std::vector<unsigned char> &&records)
+{
+    if (m_compacting.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    waitCompaction();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_file || m_failed)
+    {
+        return false;
+    }
+
+    // 旧日志段必须先完整落盘，否则崩溃后可能出现新日志段中的操作在而之前的操作丢失
+    if (!writeBatch() || !skipListSyncFile(m_file))
+    {
+        m_failed = true;
+        return false;
+    }
+
+    auto file = createFile(segmentPath(m_seq + 1), m_seq + 1);
+    if (!file)
+    {
+        // 当前日志段仍然可用，推迟重试，否则之后每次修改都会重新编码全部数据
+        m_compactSize.store(m_segmentSize.load(std::memory_order_relaxed) + m_compactThreshold, std::memory_order_relaxed);
+        return false;
+    }
+
+    fclose(m_file);
+    m_file = file;
+    ++m_seq;
+    m_segmentSize.store(sizeof(OpLogHeader), std::memory_order_relaxed);
+    m_compactSize.store(m_compactThreshold, std::memory_order_relaxed);
+
+    m_compacting.store(true, std::memory_order_release);
+    m_compactThread = std::thread(&SkipListOpLog::compactLoop, this, std::move(records), m_seq);
+
+    return true;
+}
+
+bool SkipListOpLog::waitCompaction()
+{
+    if (m_compactThread.joinable())
+    {
+        m_compactThread.join();
+    }
+    return m_compactOk;
+}
+
+bool SkipListOpLog::replayFile(const std::string &path, uint64_t *seq, bool matchSeq, uint64_t *size, ReplayFunc replayFunc, void *context)
+{
+    auto file = fopen(path.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> content;
+    unsigned char chunk[1 << 16];
+    size_t count;
+    while ((count = fread(chunk, 1, sizeof chunk, file)) > 0)
+    {
+        content.insert(content.end(), chunk, chunk + count);
+    }
+    fclose(file);
+
+    OpLogHeader header;
+    if (content.size() < sizeof header)
+    {
+        return false;
+    }
+    memcpy(&header, content.data(), sizeof header);
+    if (memcmp(header.m_magic, OP_LOG_MAGIC, sizeof header.m_magic) != 0 || header.m_version != OP_LOG_VERSION ||
+        (matchSeq && header.m_seq != *seq))
+    {
+        return false;
+    }
+    *seq = header.m_seq;
+
+    auto offset = sizeof header;
+    while (content.size() - offset >= FRAME_HEADER_SIZE)
+    {
+        uint64_t frameSize, checksum;
+        memcpy(&frameSize, content.data() + offset, sizeof frameSize);
+        memcpy(&checksum, content.data() + offset + sizeof frameSize, sizeof checksum);
+
+        auto records = content.data() + offset + FRAME_HEADER_SIZE;
+        if (frameSize > content.size() - offset - FRAME_HEADER_SIZE ||
+            skipListChecksum(frameSize, records, frameSize) != checksum)
+        {
+            break;
+        }
+
+        auto end = records + frameSize;
+        for (auto cursor = records; (size_t)(end - cursor) >= RECORD_HEADER_SIZE;)
+        {
+            int64_t score;
+            uint32_t length;
+            auto type = (OpType)cursor[0];
+            memcpy(&score, cursor + 1, sizeof score);
+            memcpy(&length, cursor + 1 + sizeof score, sizeof length);
+            cursor += RECORD_HEADER_SIZE;
+            if ((size_t)(end - cursor) < length)
+            {
+                break;
+            }
+
+            replayFunc(context, type, score, std::string_view{reinterpret_cast<const char *>(cursor), length});
+            cursor += length;
+        }
+
+        offset += FRAME_HEADER_SIZE + frameSize;
+    }
+
+    // 截掉崩溃时没写完的尾部，之后的追加接在完整的帧后面
+    if (offset != content.size())
+    {
+        skipListTruncateFile(path.c_str(), offset);
+    }
+    *size = offset;
+
+    return true;
+}
+
+FILE *SkipListOpLog::createFile(const std::string &path, uint64_t seq)
+{
+    auto file = fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        return nullptr;
+    }
+
+    OpLogHeader header = {};
+    memcpy(header.m_magic, OP_LOG_MAGIC, sizeof header.m_magic);
+    header.m_version = OP_LOG_VERSION;
+    header.m_seq = seq;
+    if (fwrite(&header, sizeof header, 1, file) != 1 || !skipListSyncFile(file))
+    {
+        fclose(file);
+        std::remove(path.c_str());
+        return nullptr;
+    }
+
+    return file;
+}
+
+bool SkipListOpLog::writeFrame(FILE *file, const unsigned char *records, size_t size)
+{
+    uint64_t frameHeader[2] = {size, skipListChecksum(size, records, size)};
+    return fwrite(frameHeader, sizeof frameHeader, 1, file) == 1 &&
+           fwrite(records, 1, size, file) == size && fflush(file) == 0;
+}
+
+bool SkipListOpLog::writeBatch()
+{
+    if (m_buffer.empty())
+    {
+        return !m_failed;
+    }
+
+    if (!m_failed)
+    {
+        if (!m_file || !writeFrame(m_file, m_buffer.data(), m_buffer.size()) ||
+            (m_syncPolicy == SyncPolicy::ALWAYS && !skipListSyncFile(m_file)))
+        {
+            m_failed = true;
+        }
+        m_segmentSize.fetch_add(FRAME_HEADER_SIZE + m_buffer.size(), std::memory_order_relaxed);
+    }
+    m_buffer.clear();
+
+    return !m_failed;
+}
+
+void SkipListOpLog::syncLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_syncCond.wait_for(lock, std::chrono::seconds(1), [this]()
+                                { return m_stopping; }))
+    {
+        if (!writeBatch())
+        {
+            continue;
+        }
+
+        // 刷盘可能很慢，复制一个文件描述符后在锁外进行，不阻塞追加
+#ifdef _WIN32
+        auto fd = _dup(_fileno(m_file));
+#else
+        auto fd = dup(fileno(m_file));
+#endif
+        lock.unlock();
+        if (fd >= 0)
+        {
+#ifdef _WIN32
+            _commit(fd);
+            _close(fd);
+#else
+            fsync(fd);
+            ::close(fd);
+#endif
+        }
+        lock.lock();
+    }
+}
+
+void SkipListOpLog::compactLoop(std::vector<unsigned char> records, uint64_t seq)
+{
+    // 基准文件先写到临时文件，刷盘后再原子地替换
+    auto tmpPath = basePath() + ".tmp";
+    auto file = createFile(tmpPath, seq);
+    auto ok = file != nullptr;
+    if (file)
+    {
+        ok = writeFrame(file, records.data(), records.size()) && skipListSyncFile(file);
+        ok = fclose(file) == 0 && ok;
+    }
+    ok = ok && skipListReplaceFile(tmpPath.c_str(), basePath().c_str());
+
+    if (ok)
+    {
+        for (; m_baseSeq < seq; ++m_baseSeq)
+        {
+            std::remove(segmentPath(m_baseSeq).c_str());
+        }
+    }
+    else
+    {
+        std::remove(tmpPath.c_str());
+    }
+
+    m_compactOk = ok;
+    m_compacting.store(false, std::memory_order_release);
+}
@@ -0,0 +1,187 @@
+#ifndef _SKIPLIST_OP_LOG_H_
+#define _SKIPLIST_OP_LOG_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// 跳表的追加式操作日志：
+// 每条记录为{操作类型, score, 数据的字节}，先追加到内存缓冲区，攒满一批后作为一帧写入文件，
+// 每帧带有长度和校验和，重放时遇到不完整或校验失败的帧即认为是崩溃时未写完的尾部并截掉。
+// 日志段文件为path.<序号>，压缩时切换到下一个序号的日志段，
+// 由后台线程把当前全部数据作为插入记录写成基准文件path.base，再删除之前的日志段；
+// 基准文件头中记录它之后第一个日志段的序号，重放时跳过更早的日志段，
+// 旧日志段在基准文件替换成功后才删除，因此压缩过程中任意时刻崩溃，每个操作都恰好重放一次。
+class SkipListOpLog
+{
+public:
+    // 刷盘策略
+    enum class SyncPolicy
+    {
+        // 每写入一帧都刷盘，调用者在一批操作后调用flush实现组提交
+        ALWAYS,
+        // 后台线程每秒写入缓冲区并刷盘，崩溃最多丢失约1秒的操作
+        EVERY_SECOND,
+        // 只在缓冲区满、flush和close时写入文件，由操作系统决定何时刷盘
+        NEVER,
+    };
+
+    enum OpType : unsigned char
+    {
+        OP_INSERT = 1,
+        OP_REMOVE = 2,
+    };
+
+    // 重放回调
+    using ReplayFunc = void (*)(void *context, OpType type, long long score, std::string_view bytes);
+
+    // compactThreshold为触发压缩的日志段大小
+    explicit SkipListOpLog(std::string path, SyncPolicy syncPolicy = SyncPolicy::EVERY_SECOND,
+                           uint64_t compactThreshold = 64 << 20);
+    ~SkipListOpLog();
+
+    SkipListOpLog(const SkipListOpLog &) = delete;
+    SkipListOpLog &operator=(const SkipListOpLog &) = delete;
+
+    // 按顺序重放基准文件和日志段，截掉末尾不完整的帧，之后可以追加
+    bool open(ReplayFunc replayFunc, void *context);
+    // 等待进行中的压缩，写入缓冲区并刷盘后关闭
+    bool close();
+    bool isOpen() const { return m_file != nullptr; }
+
+    // 追加一条记录到缓冲区，缓冲区攒满一批时写入文件
+    void append(OpType type, long long score, std::string_view bytes);
+    // 将缓冲区写入文件，SyncPolicy::ALWAYS时同时刷盘
+    bool flush();
+    // 将缓冲区写入文件并刷盘
+    bool sync();
+    // 写入或刷盘是否出过错，出错后不再写入
+    bool failed() const { return m_failed; }
+
+    // 当前日志段达到压缩大小、没有进行中的压缩且日志没有出错；
+    // 调用者应先检查此函数再编码全部数据，避免每次修改都重复编码
+    bool needCompaction() const
+    {
+        return !m_failed.load(std::memory_order_relaxed) &&
+               m_segmentSize.load(std::memory_order_relaxed) >= m_compactSize.load(std::memory_order_relaxed) &&
+               !m_compacting.load(std::memory_order_acquire);
+    }
+    // 开始后台压缩，records为当前全部数据的插入记录(用encodeRecord编码)：
+    // 先切换到新的日志段，再由后台线程写出基准文件并删除旧日志段；
+    // 新日志段创建失败时继续写当前日志段，再写入一个压缩阈值的数据后才重试
+    bool compact(std::vector<unsigned char> &&records);
+    // 等待进行中的压缩完成，返回压缩是否成功
+    bool waitCompaction();
+
+    // 将一条记录编码追加到buffer
+    static void encodeRecord(std::vector<unsigned char> &buffer, OpType type, long long score, std::string_view bytes)
+    {
+        int64_t recordScore = score;
+        uint32_t length = (uint32_t)bytes.size();
+        auto offset = buffer.size();
+        buffer.resize(offset + RECORD_HEADER_SIZE + length);
+        auto record = buffer.data() + offset;
+        record[0] = type;
+        memcpy(record + 1, &recordScore, sizeof recordScore);
+        memcpy(record + 1 + sizeof recordScore, &length, sizeof length);
+        memcpy(record + RECORD_HEADER_SIZE, bytes.data(), length);
+    }
+
+protected:
+    // 记录中操作类型、score和数据长度占用的字节数
+    const static size_t RECORD_HEADER_SIZE = 1 + sizeof(int64_t) + sizeof(uint32_t);
+    // 帧头：8字节数据长度和8字节校验和
+    const static size_t FRAME_HEADER_SIZE = 2 * sizeof(uint64_t);
+    // 缓冲区攒到这么多字节时写入一帧
+    const static size_t BATCH_SIZE = 64 << 10;
+
+    // 日志段和基准文件的路径
+    std::string segmentPath(uint64_t seq) const { return m_path + "." + std::to_string(seq); }
+    std::string basePath() const { return m_path + ".base"; }
+
+    // 读取日志文件并重放，返回文件头中的序号和有效部分的长度，并截掉末尾不完整的帧；
+    // matchSeq为true时要求文件头中的序号等于*seq，文件不存在或文件头无效时返回false
+    static bool replayFile(const std::string &path, uint64_t *seq, bool matchSeq, uint64_t *size, ReplayFunc replayFunc, void *context);
+    // 创建日志文件，写入文件头并刷盘
+    static FILE *createFile(const std::string &path, uint64_t seq);
+    // 将size字节的记录作为一帧写入file
+    static bool writeFrame(FILE *file, const unsigned char *records, size_t size);
+
+    // 将缓冲区作为一帧写入当前日志段，要求持有m_mutex
+    bool writeBatch();
+
+    // 后台刷盘线程
+    void syncLoop();
+    // 后台压缩线程
+    void compactLoop(std::vector<unsigned char> records, uint64_t seq);
+
+    std::string m_path;
+    SyncPolicy m_syncPolicy;
+    uint64_t m_compactThreshold;
+
+    // 保护缓冲区和当前日志段
+    std::mutex m_mutex;
+    FILE *m_file = nullptr;
+    // 当前日志段的序号
+    uint64_t m_seq = 0;
+    // 基准文件之后第一个日志段的序号，只在open和压缩线程中访问
+    uint64_t m_baseSeq = 0;
+    // 待写入的记录
+    std::vector<unsigned char> m_buffer;
+    // 在m_mutex内修改，needCompaction和failed在锁外读取
+    std::atomic<bool> m_failed{false};
+    // 当前日志段已写入的字节数
+    std::atomic<uint64_t> m_segmentSize{0};
+    // 当前日志段达到这个大小时压缩，切换日志段失败后推迟一个压缩阈值
+    std::atomic<uint64_t> m_compactSize{0};
+
+    std::thread m_syncThread;
+    std::condition_variable m_syncCond;
+    bool m_stopping = false;
+
+    std::thread m_compactThread;
+    std::atomic<bool> m_compacting{false};
+    bool m_compactOk = true;
+};
+
+// 数据与操作日志中字节的转换，可以平凡拷贝的类型按字节拷贝，其他类型需要特化，
+// SUPPORTED为false的类型不能挂接操作日志
+template <typename T, typename = void>
+struct SkipListOpLogCodec
+{
+    static const bool SUPPORTED = false;
+};
+
+template <typename T>
+struct SkipListOpLogCodec<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+{
+    static const bool SUPPORTED = true;
+
+    static std::string_view toBytes(const T &data) { return {reinterpret_cast<const char *>(&data), sizeof(T)}; }
+    static T fromBytes(std::string_view bytes)
+    {
+        T data{};
+        memcpy(&data, bytes.data(), std::min(bytes.size(), sizeof(T)));
+        return data;
+    }
+};
+
+template <>
+struct SkipListOpLogCodec<std::string>
+{
+    static const bool SUPPORTED = true;
+
+    static std::string_view toBytes(const std::string &data) { return data; }
+    static std::string fromBytes(std::string_view bytes) { return std::string{bytes}; }
+};
+
+#endif
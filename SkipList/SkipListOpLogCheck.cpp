@@ -0,0 +1,303 @@
+// 操作日志的重放测试，以SortedSet为例与std::map模型对照：
+//   g++ -std=c++17 -O2 SkipListOpLogCheck.cpp SortedSet.cpp SkipList1.cpp SkipListOpLog.cpp -pthread -o oplog_check
+// 覆盖关闭后重放、多次压缩后重放、末尾不完整的帧，以及切换日志段失败后的退避。
+// 日志文件写在当前目录的oplog_check.dir下，全部检查通过时返回0。
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "SortedSet.h"
+
+namespace fs = std::filesystem;
+
+static const char *LOG_DIR = "oplog_check.dir";
+
+// xorshift64，生成测试用的member和score
+static uint64_t nextRandom(uint64_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// 模型：member到score
+using Model = std::map<std::string, long long>;
+
+// 随机add/remove/incrBy/removeRangeByScore，同时更新模型
+static void randomOps(SortedSet &sortedSet, Model &model, int opCount, uint64_t &state)
+{
+    for (int i = 0; i < opCount; ++i)
+    {
+        auto random = nextRandom(state);
+        auto member = "m" + std::to_string(random % 3000);
+        long long score = (long long)(random / 4096 % 1000);
+        switch (random / 65536 % 8)
+        {
+        case 0:
+        case 1:
+        case 2:
+            sortedSet.add(member, score);
+            model[member] = score;
+            break;
+        case 3:
+        case 4:
+            sortedSet.remove(member);
+            model.erase(member);
+            break;
+        case 5:
+        case 6:
+            model[member] = sortedSet.incrBy(member, score);
+            break;
+        default:
+        {
+            SortedSet::ScoreRange range;
+            range.m_min = score;
+            range.m_max = score + 1;
+            sortedSet.removeRangeByScore(range);
+            for (auto it = model.begin(); it != model.end();)
+            {
+                it = it->second >= range.m_min && it->second <= range.m_max ? model.erase(it) : std::next(it);
+            }
+            break;
+        }
+        }
+    }
+}
+
+// 按{score, member}顺序逐项对照
+static bool compareAll(SortedSet &sortedSet, const Model &model)
+{
+    std::set<std::pair<long long, std::string>> orderSet;
+    for (auto &item : model)
+    {
+        orderSet.emplace(item.second, item.first);
+    }
+
+    std::vector<std::pair<std::string_view, long long>> result;
+    sortedSet.rangeByRank(0, -1, result);
+    if (result.size() != orderSet.size())
+    {
+        printf("size mismatch %zu != %zu\n", result.size(), orderSet.size());
+        return false;
+    }
+    auto it = orderSet.begin();
+    for (auto &item : result)
+    {
+        if (item.first != it->second || item.second != it->first)
+        {
+            printf("content mismatch at member %s\n", it->second.c_str());
+            return false;
+        }
+        ++it;
+    }
+
+    return true;
+}
+
+// 用新的SortedSet重放日志，与模型对照，重放后日志保持打开供调用者继续追加
+static bool replayAndCompare(SortedSet &sortedSet, SkipListOpLog &opLog, const Model &model)
+{
+    if (!sortedSet.attachOpLog(&opLog))
+    {
+        printf("attach failed\n");
+        return false;
+    }
+    return compareAll(sortedSet, model);
+}
+
+// 当前日志段，即序号最大的path.<序号>
+static std::string lastSegment(const std::string &path)
+{
+    std::string last;
+    uint64_t lastSeq = 0;
+    for (auto &entry : fs::directory_iterator(LOG_DIR))
+    {
+        auto name = entry.path().string();
+        // 跳过path.base和压缩时的临时文件
+        if (name.rfind(path + ".", 0) != 0 || !isdigit((unsigned char)name[path.size() + 1]))
+        {
+            continue;
+        }
+        auto seq = std::stoull(name.substr(path.size() + 1));
+        if (last.empty() || seq > lastSeq)
+        {
+            last = name;
+            lastSeq = seq;
+        }
+    }
+    return last;
+}
+
+// 关闭后重放：没有压缩，全部操作都在0号日志段
+static bool verifyReopen(const std::string &path)
+{
+    Model model;
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    {
+        SkipListOpLog opLog{path, SkipListOpLog::SyncPolicy::NEVER};
+        SortedSet sortedSet;
+        if (!sortedSet.attachOpLog(&opLog))
+        {
+            return false;
+        }
+        randomOps(sortedSet, model, 50000, state);
+        if (!opLog.close())
+        {
+            printf("close failed\n");
+            return false;
+        }
+    }
+
+    SkipListOpLog opLog{path};
+    SortedSet sortedSet;
+    return replayAndCompare(sortedSet, opLog, model) && !fs::exists(path + ".base");
+}
+
+// 压缩阈值很小，修改过程中多次压缩，重放基准文件和之后的日志段
+static bool verifyCompaction(const std::string &path)
+{
+    Model model;
+    uint64_t state = 0x2545f4914f6cdd1dull;
+    uint64_t lastSeq = 0;
+    for (int round = 0; round < 3; ++round)
+    {
+        SkipListOpLog opLog{path, SkipListOpLog::SyncPolicy::NEVER, 256 << 10};
+        SortedSet sortedSet;
+        if (!replayAndCompare(sortedSet, opLog, model))
+        {
+            printf("round %d\n", round);
+            return false;
+        }
+        randomOps(sortedSet, model, 100000, state);
+        if (!opLog.close() || opLog.failed())
+        {
+            printf("close failed in round %d\n", round);
+            return false;
+        }
+
+        // 每一轮都要发生过压缩，且旧日志段已被删除
+        auto last = lastSegment(path);
+        auto seq = std::stoull(last.substr(path.size() + 1));
+        if (!fs::exists(path + ".base") || seq <= lastSeq || fs::exists(path + "." + std::to_string(lastSeq)))
+        {
+            printf("no compaction in round %d, segment %s\n", round, last.c_str());
+            return false;
+        }
+        lastSeq = seq;
+    }
+
+    SkipListOpLog opLog{path};
+    SortedSet sortedSet;
+    return replayAndCompare(sortedSet, opLog, model);
+}
+
+// 末尾不完整的帧：重放时截掉，之后的追加接在完整的帧后面
+static bool verifyTornFrame(const std::string &path)
+{
+    Model model;
+    uint64_t state = 0x853c49e6748fea9bull;
+    {
+        SkipListOpLog opLog{path, SkipListOpLog::SyncPolicy::ALWAYS};
+        SortedSet sortedSet;
+        if (!sortedSet.attachOpLog(&opLog))
+        {
+            return false;
+        }
+        randomOps(sortedSet, model, 20000, state);
+        opLog.close();
+    }
+
+    // 写一个帧头声明的长度超过文件剩余部分的帧，模拟写到一半时崩溃
+    auto segment = lastSegment(path);
+    auto size = fs::file_size(segment);
+    {
+        auto file = fopen(segment.c_str(), "ab");
+        uint64_t frameHeader[2] = {1000, 0};
+        fwrite(frameHeader, sizeof frameHeader, 1, file);
+        fwrite("torn", 1, 4, file);
+        fclose(file);
+    }
+
+    {
+        SkipListOpLog opLog{path, SkipListOpLog::SyncPolicy::ALWAYS};
+        SortedSet sortedSet;
+        if (!replayAndCompare(sortedSet, opLog, model) || fs::file_size(segment) != size)
+        {
+            printf("torn frame not truncated\n");
+            return false;
+        }
+        sortedSet.add("after-torn", -1);
+        model["after-torn"] = -1;
+        opLog.close();
+    }
+
+    SkipListOpLog opLog{path};
+    SortedSet sortedSet;
+    return replayAndCompare(sortedSet, opLog, model);
+}
+
+// 下一个日志段无法创建时，压缩退避一个阈值而不是每次修改都重新编码全部数据；
+// 日志本身仍然可用，障碍去掉后下一次压缩成功
+static bool verifyCompactionBackoff(const std::string &path)
+{
+    const uint64_t THRESHOLD = 64 << 10;
+    Model model;
+    uint64_t state = 0xda942042e4dd58b5ull;
+
+    SkipListOpLog opLog{path, SkipListOpLog::SyncPolicy::NEVER, THRESHOLD};
+    SortedSet sortedSet;
+    if (!sortedSet.attachOpLog(&opLog))
+    {
+        return false;
+    }
+
+    // 占用1号日志段的路径，fopen失败
+    auto blocker = path + ".1";
+    fs::create_directory(blocker);
+    randomOps(sortedSet, model, 10000, state);
+    if (opLog.needCompaction() || opLog.failed() || fs::exists(path + ".base"))
+    {
+        printf("compaction did not back off\n");
+        return false;
+    }
+
+    fs::remove(blocker);
+    randomOps(sortedSet, model, 20000, state);
+    if (!opLog.waitCompaction() || !opLog.close() || !fs::exists(path + ".base"))
+    {
+        printf("compaction not retried\n");
+        return false;
+    }
+
+    SkipListOpLog reopened{path};
+    SortedSet replayed;
+    return replayAndCompare(replayed, reopened, model);
+}
+
+int main()
+{
+    printf("begin\n");
+
+    fs::remove_all(LOG_DIR);
+    fs::create_directory(LOG_DIR);
+    auto dir = std::string{LOG_DIR} + "/";
+
+    bool ok = true;
+    ok = verifyReopen(dir + "reopen") && ok;
+    ok = verifyCompaction(dir + "compact") && ok;
+    ok = verifyTornFrame(dir + "torn") && ok;
+    ok = verifyCompactionBackoff(dir + "backoff") && ok;
+
+    fs::remove_all(LOG_DIR);
+
+    printf("%s\n", ok ? "ok" : "FAILED");
+    printf("end\n");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#ifndef _SKIPLIST_STATS_H_
+#define _SKIPLIST_STATS_H_
+
+#include <cstddef>
+#include <vector>
+
+// 编译时定义SKIPLIST_STATS后，跳表在查找(findLastLessThan)中统计比较次数和各层前进经过的节点数；
+// 未定义时计数器成员不存在，SKIPLIST_COUNT展开为空，热路径上没有任何额外开销。
+// 该宏改变跳表对象的布局，同一程序的所有编译单元必须一致地定义或不定义
+#ifdef SKIPLIST_STATS
+#define SKIPLIST_COUNT(expr) (void)(expr)
+#else
+#define SKIPLIST_COUNT(expr) ((void)0)
+#endif
+
+// 查找路径上的计数器，只在定义SKIPLIST_STATS时作为跳表的成员存在
+template <unsigned char MaxLevel>
+struct SkipListCounters
+{
+    // 查找次数
+    unsigned long long m_searchCount = 0;
+    // 每层停止前进时与后继的比较次数，前进经过的节点各比较一次，计入m_visitArray
+    unsigned long long m_stopCount = 0;
+    // 各层前进经过的节点数
+    unsigned long long m_visitArray[MaxLevel] = {};
+};
+
+// 跳表的统计信息，由各跳表的stats()生成
+struct SkipListStats
+{
+    // 是否编译了查找计数器，为false时m_searchCount/m_compareCount为0，m_visitArray为空
+    bool m_counting = false;
+    // 查找次数
+    unsigned long long m_searchCount = 0;
+    // 查找中与目标比较的次数
+    unsigned long long m_compareCount = 0;
+    // m_visitArray[i]为查找在第i层前进经过的节点数
+    std::vector<unsigned long long> m_visitArray;
+
+    // m_heightArray[h - 1]为层高为h的节点数
+    std::vector<unsigned long> m_heightArray;
+    // 当前的最大层高
+    unsigned char m_level = 0;
+    // 节点总数
+    unsigned long m_length = 0;
+    // 全部数据节点占用的字节数，不含头节点
+    size_t m_nodeBytes = 0;
+    // 总字节数：跳表对象、头节点和全部数据节点
+    size_t m_totalBytes = 0;
+
+    // 平均每次查找的比较次数
+    double comparesPerSearch() const { return m_searchCount ? (double)m_compareCount / m_searchCount : 0; }
+    // 平均每个数据节点的字节数
+    double bytesPerNode() const { return m_length ? (double)m_nodeBytes / m_length : 0; }
+
+    // 复制查找计数器，m_visitArray去掉末尾没有访问的层
+    template <unsigned char MaxLevel>
+    void setCounters(const SkipListCounters<MaxLevel> &counters)
+    {
+        m_counting = true;
+        m_searchCount = counters.m_searchCount;
+        m_compareCount = counters.m_stopCount;
+        m_visitArray.assign(counters.m_visitArray, counters.m_visitArray + MaxLevel);
+        while (!m_visitArray.empty() && m_visitArray.back() == 0)
+        {
+            m_visitArray.pop_back();
+        }
+        for (auto visit : m_visitArray)
+        {
+            m_compareCount += visit;
+        }
+    }
+
+    // 从头节点沿各层逐个计数得到层高分布和节点字节数，不要求节点记录自己的层高，耗时O(n)；
+    // nodeSize(h)为层高为h的节点占用的字节数
+    template <class SkipNode, class NodeSize>
+    void countNodes(const SkipNode *head, unsigned char level, NodeSize &&nodeSize)
+    {
+        m_level = level;
+        m_heightArray.assign(level, 0);
+        m_nodeBytes = 0;
+
+        // 先统计层高不低于i + 1的节点数，相邻两层相减即为层高恰为i + 1的节点数
+        for (unsigned char i = 0; i < level; ++i)
+        {
+            for (auto node = head->m_levelArray[i].m_next; node; node = node->m_levelArray[i].m_next)
+            {
+                ++m_heightArray[i];
+            }
+        }
+        for (unsigned char i = 0; i < level; ++i)
+        {
+            if (i + 1 < level)
+            {
+                m_heightArray[i] -= m_heightArray[i + 1];
+            }
+            m_nodeBytes += m_heightArray[i] * nodeSize(i + 1);
+        }
+    }
+};
+
+#endif // _SKIPLIST_STATS_H_
@@ -0,0 +1,28 @@
+#ifndef _SKIPLIST_TRAITS_H_
+#define _SKIPLIST_TRAITS_H_
+
+#include <type_traits>
+
+// 比较器是否定义了is_transparent，即是否支持与T以外的类型比较
+template <class CmpLess, class = void>
+struct SkipListIsTransparent : std::false_type
+{
+};
+
+template <class CmpLess>
+struct SkipListIsTransparent<CmpLess, std::void_t<typename CmpLess::is_transparent>> : std::true_type
+{
+};
+
+// 层高策略是否要求跳表用1-2-3平衡模式维持层高
+template <class LevelGen, class = void>
+struct SkipListIsDeterministic : std::false_type
+{
+};
+
+template <class LevelGen>
+struct SkipListIsDeterministic<LevelGen, std::enable_if_t<LevelGen::DETERMINISTIC>> : std::true_type
+{
+};
+
+#endif // _SKIPLIST_TRAITS_H_
@@ -0,0 +1,415 @@
+#include <cstring>
+#include <functional>
+#include "SortedSet.h"
+
+SortedSet::SortedSet(uint64_t levelSeed)
+    : SkipList{compareMember, levelSeed}
+{
+    m_slotArray = new Slot[INIT_CAPACITY];
+    m_capacity = INIT_CAPACITY;
+}
+
+SortedSet::~SortedSet()
+{
+    // 节点及其member由SkipList的析构函数释放
+    delete[] m_slotArray;
+}
+
+bool SortedSet::add(std::string_view member, long long score)
+{
+    auto hash = hashMember(member);
+    auto index = findSlot(member, hash);
+    auto node = m_slotArray[index].m_node;
+    if (node)
+    {
+        updateNodeScore(node, score);
+        return false;
+    }
+
+    insertMemberNode(member, hash, index, score);
+
+    return true;
+}
+
+long long SortedSet::incrBy(std::string_view member, long long increment)
+{
+    auto hash = hashMember(member);
+    auto index = findSlot(member, hash);
+    auto node = m_slotArray[index].m_node;
+    if (node)
+    {
+        updateNodeScore(node, node->m_score + increment);
+        return node->m_score;
+    }
+
+    insertMemberNode(member, hash, index, increment);
+
+    return increment;
+}
+
+bool SortedSet::remove(std::string_view member)
+{
+    SkipNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+
+    auto index = findSlot(member, hashMember(member));
+    auto node = m_slotArray[index].m_node;
+    if (!node)
+    {
+        return false;
+    }
+
+    findLastLessThan(node->m_score, node->m_data, updateArray, rankArray);
+    unlinkNode(node, updateArray);
+    if (m_opLog)
+    {
+        logOp(SkipListOpLog::OP_REMOVE, node->m_score, node->m_data);
+    }
+
+    eraseSlot(index);
+    releaseNode(node);
+
+    return true;
+}
+
+bool SortedSet::score(std::string_view member, long long *score) const
+{
+    auto node = m_slotArray[findSlot(member, hashMember(member))].m_node;
+    if (!node)
+    {
+        return false;
+    }
+
+    if (score)
+    {
+        *score = node->m_score;
+    }
+
+    return true;
+}
+
+long SortedSet::rank(std::string_view member)
+{
+    auto node = m_slotArray[findSlot(member, hashMember(member))].m_node;
+    if (!node)
+    {
+        return -1;
+    }
+
+    return getRank(node->m_score, node->m_data);
+}
+
+void SortedSet::rangeByRank(long start, long stop, std::vector<std::pair<std::string_view, long long>> &result)
+{
+    result.clear();
+
+    if (start < 0)
+    {
+        start += m_length;
+    }
+    if (stop < 0)
+    {
+        stop += m_length;
+    }
+    if (start < 0)
+    {
+        start = 0;
+    }
+    if (stop >= (long)m_length)
+    {
+        stop = m_length - 1;
+    }
+    if (start > stop)
+    {
+        return;
+    }
+
+    result.reserve(stop - start + 1);
+    auto node = findByRank(start + 1);
+    for (auto i = start; i <= stop; ++i)
+    {
+        result.emplace_back(toMember(node->m_data), node->m_score);
+        node = node->m_levelArray[0].m_next;
+    }
+}
+
+unsigned long SortedSet::removeRangeByRank(long start, long stop)
+{
+    // 摘除的节点经由重写的releaseNodeList同时从哈希表中删除
+    return SkipList::removeRangeByRank(start, stop);
+}
+
+unsigned long SortedSet::removeRangeByScore(const ScoreRange &range)
+{
+    return SkipList::removeRangeByScore(range);
+}
+
+bool SortedSet::saveSnapshot(const char *path) const
+{
+    return SkipList::saveSnapshot(path, toMember);
+}
+
+bool SortedSet::loadSnapshot(const char *path)
+{
+    if (m_length)
+    {
+        return false;
+    }
+
+    SnapshotFile file;
+    if (!file.open(path))
+    {
+        return false;
+    }
+
+    // 按最终的member个数一次扩容，保持负载因子不超过3/4
+    auto capacity = m_capacity;
+    while (file.count() * 4 > capacity * 3)
+    {
+        capacity *= 2;
+    }
+    if (capacity != m_capacity)
+    {
+        rehash(capacity);
+    }
+
+    SkipNode *lastArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+    beginAppend(lastArray, rankArray);
+
+    // 快照必须按{score, member}严格递增且member不重复，否则直接链接会破坏跳表顺序和哈希表
+    bool valid = true;
+    long long score;
+    std::string_view member;
+    while (file.next(&score, &member))
+    {
+        auto hash = hashMember(member);
+        auto &slot = m_slotArray[findSlot(member, hash)];
+        if (slot.m_node)
+        {
+            valid = false;
+            break;
+        }
+
+        auto node = createMemberNode(member, score);
+        auto prevNode = lastArray[0];
+        if (prevNode != m_head &&
+            (prevNode->m_score > score || (prevNode->m_score == score && compareMember(prevNode->m_data, node->m_data) >= 0)))
+        {
+            releaseNode(node);
+            valid = false;
+            break;
+        }
+
+        appendNode(node, lastArray, rankArray);
+        slot.m_hash = hash;
+        slot.m_node = node;
+    }
+
+    endAppend(lastArray, rankArray);
+
+    if (!valid)
+    {
+        // 丢弃已加载的部分，此前还没有写日志，清空时也不写
+        auto opLog = m_opLog;
+        m_opLog = nullptr;
+        releaseNodeList(detachRange(1, m_length), nullptr);
+        m_opLog = opLog;
+        return false;
+    }
+
+    // 全部校验通过后再写日志，失败时日志中不会留下半个快照
+    if (m_opLog)
+    {
+        for (auto node = m_head->m_levelArray[0].m_next; node; node = node->m_levelArray[0].m_next)
+        {
+            logOp(SkipListOpLog::OP_INSERT, node->m_score, node->m_data);
+        }
+    }
+
+    return true;
+}
+
+bool SortedSet::attachOpLog(SkipListOpLog *opLog)
+{
+    // 重放时不能再写回日志
+    m_opLog = nullptr;
+    m_dataToBytes = toMember;
+    if (!opLog)
+    {
+        return true;
+    }
+
+    if (!opLog->open(replayOp, this))
+    {
+        return false;
+    }
+    m_opLog = opLog;
+
+    return true;
+}
+
+void SortedSet::replayOp(void *context, SkipListOpLog::OpType type, long long score, std::string_view member)
+{
+    auto sortedSet = static_cast<SortedSet *>(context);
+    if (type == SkipListOpLog::OP_INSERT)
+    {
+        sortedSet->add(member, score);
+    }
+    else if (type == SkipListOpLog::OP_REMOVE)
+    {
+        sortedSet->remove(member);
+    }
+}
+
+uint64_t SortedSet::hashMember(std::string_view member)
+{
+    return std::hash<std::string_view>{}(member);
+}
+
+std::string_view SortedSet::toMember(const void *data)
+{
+    auto member = static_cast<const Member *>(data);
+    return std::string_view{member->m_data, member->m_length};
+}
+
+int SortedSet::compareMember(void *a, void *b)
+{
+    return toMember(a).compare(toMember(b));
+}
+
+SortedSet::SkipNode *SortedSet::createMemberNode(std::string_view member, long long score)
+{
+    auto level = genLevel();
+    auto node = createNode(level, offsetof(Member, m_data) + member.size());
+
+    auto memberData = reinterpret_cast<Member *>(reinterpret_cast<char *>(node) + nodeSize(level));
+    memberData->m_length = member.size();
+    memcpy(memberData->m_data, member.data(), member.size());
+
+    node->m_score = score;
+    node->m_data = memberData;
+
+    return node;
+}
+
+void SortedSet::insertMemberNode(std::string_view member, uint64_t hash, size_t index, long long score)
+{
+    SkipNode *updateArray[MAX_LEVEL];
+    unsigned long rankArray[MAX_LEVEL];
+
+    auto node = createMemberNode(member, score);
+
+    findLastLessThan(score, node->m_data, updateArray, rankArray);
+    linkNode(node, updateArray, rankArray);
+
+    m_slotArray[index].m_hash = hash;
+    m_slotArray[index].m_node = node;
+
+    if (m_opLog)
+    {
+        logOp(SkipListOpLog::OP_INSERT, score, node->m_data);
+    }
+
+    // 负载因子超过3/4时扩容
+    if (m_length * 4 > m_capacity * 3)
+    {
+        rehash(m_capacity * 2);
+    }
+}
+
+void SortedSet::updateNodeScore(SkipNode *node, long long score)
+{
+    // 节点直接由哈希表得到，顺序不变时无需查找
+    if (scoreFitsInPlace(node, score))
+    {
+        node->m_score = score;
+    }
+    else
+    {
+        SkipNode *updateArray[MAX_LEVEL];
+        unsigned long rankArray[MAX_LEVEL];
+
+        findLastLessThan(node->m_score, node->m_data, updateArray, rankArray);
+        relinkNode(node, score, updateArray, rankArray);
+    }
+
+    // 重放时add覆盖原有的score
+    if (m_opLog)
+    {
+        logOp(SkipListOpLog::OP_INSERT, score, node->m_data);
+    }
+}
+
+void SortedSet::releaseNodeList(SkipNode *node, std::vector<std::pair<long long, void *>> *removed)
+{
+    // 节点释放后member不再可读，必须先删除槽位
+    for (auto current = node; current; current = current->m_levelArray[0].m_next)
+    {
+        auto member = toMember(current->m_data);
+        eraseSlot(findSlot(member, hashMember(member)));
+    }
+
+    SkipList::releaseNodeList(node, removed);
+}
+
+size_t SortedSet::findSlot(std::string_view member, uint64_t hash) const
+{
+    auto mask = m_capacity - 1;
+    auto index = hash & mask;
+    while (m_slotArray[index].m_node)
+    {
+        auto &slot = m_slotArray[index];
+        if (slot.m_hash == hash && toMember(slot.m_node->m_data) == member)
+        {
+            break;
+        }
+        index = (index + 1) & mask;
+    }
+
+    return index;
+}
+
+void SortedSet::eraseSlot(size_t index)
+{
+    auto mask = m_capacity - 1;
+    auto next = (index + 1) & mask;
+    while (m_slotArray[next].m_node)
+    {
+        // next处元素的探测起点不在(index, next]之间时，可以前移到index
+        auto home = m_slotArray[next].m_hash & mask;
+        if (((next - home) & mask) >= ((next - index) & mask))
+        {
+            m_slotArray[index] = m_slotArray[next];
+            index = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    m_slotArray[index].m_node = nullptr;
+}
+
+void SortedSet::rehash(size_t capacity)
+{
+    auto slotArray = new Slot[capacity];
+    auto mask = capacity - 1;
+    for (size_t i = 0; i < m_capacity; ++i)
+    {
+        auto &slot = m_slotArray[i];
+        if (!slot.m_node)
+        {
+            continue;
+        }
+
+        auto index = slot.m_hash & mask;
+        while (slotArray[index].m_node)
+        {
+            index = (index + 1) & mask;
+        }
+        slotArray[index] = slot;
+    }
+
+    delete[] m_slotArray;
+    m_slotArray = slotArray;
+    m_capacity = capacity;
+}
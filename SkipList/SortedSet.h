@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "SkipList1.h"
+
+// 有序集合：
+// 跳表按{score, member}排序，另有一个从member到跳表节点的开放寻址哈希表，
+// 按member查询score为O(1)，按member添加/删除为O(log n)。
+// member的内容与跳表节点在同一块内存中分配，跳表和哈希表都只保存节点指针。
+class SortedSet : protected SkipList
+{
+public:
+    using SkipList::ScoreRange;
+
+    explicit SortedSet(uint64_t levelSeed = 0);
+    ~SortedSet() override;
+
+    SortedSet(const SortedSet &) = delete;
+    SortedSet &operator=(const SortedSet &) = delete;
+
+    // 添加member或更新已有member的score，新增时返回true
+    bool add(std::string_view member, long long score);
+    // 将member的score增加increment，member不存在时以increment为score添加，返回新的score
+    long long incrBy(std::string_view member, long long increment);
+    // 删除member
+    bool remove(std::string_view member);
+    // 获取member的score
+    bool score(std::string_view member, long long *score) const;
+    // 获取member的排名(从0开始)，不存在时返回-1
+    long rank(std::string_view member);
+    // 获取排名在[start, stop]内的{member, score}，start/stop为负数时从尾部倒数
+    void rangeByRank(long start, long stop, std::vector<std::pair<std::string_view, long long>> &result);
+
+    // 删除排名在[start, stop]内的member，start/stop为负数时从尾部倒数，返回删除的个数
+    unsigned long removeRangeByRank(long start, long stop);
+    // 删除score在区间内的member，返回删除的个数
+    unsigned long removeRangeByScore(const ScoreRange &range);
+
+    // 按顺序将{member, score}写入快照文件
+    bool saveSnapshot(const char *path) const;
+    // 从快照文件恢复，要求集合为空，哈希表一次扩容到位，跳表按顺序直接链接；
+    // 记录不按{score, member}严格递增或member重复时返回false，集合保持为空
+    bool loadSnapshot(const char *path);
+    // 挂接操作日志：打开opLog并重放其中的操作，之后的修改都追加到日志，opLog为nullptr时取消挂接
+    bool attachOpLog(SkipListOpLog *opLog);
+
+    // member个数
+    unsigned long size() const { return m_length; }
+
+protected:
+    // 节点尾部保存的member
+    struct Member
+    {
+        size_t m_length;
+        char m_data[1];
+    };
+
+    // 哈希表槽位，m_node为空表示空槽
+    struct Slot
+    {
+        uint64_t m_hash = 0;
+        SkipNode *m_node = nullptr;
+    };
+
+    // 哈希表初始容量，必须是2的幂
+    const static size_t INIT_CAPACITY = 16;
+
+    static uint64_t hashMember(std::string_view member);
+    static std::string_view toMember(const void *data);
+    // 跳表中score相同时按member的字典序比较
+    static int compareMember(void *a, void *b);
+    // 重放操作日志：插入记录按add重放，覆盖已有的score
+    static void replayOp(void *context, SkipListOpLog::OpType type, long long score, std::string_view member);
+
+    // 创建保存member的节点，不链接
+    SkipNode *createMemberNode(std::string_view member, long long score);
+    // 创建保存member的节点并链接到跳表和哈希表的index槽位
+    void insertMemberNode(std::string_view member, uint64_t hash, size_t index, long long score);
+    // 修改已有节点的score
+    void updateNodeScore(SkipNode *node, long long score);
+
+    // 先将节点链上的member从哈希表中删除，再由SkipList记录日志并释放节点
+    void releaseNodeList(SkipNode *node, std::vector<std::pair<long long, void *>> *removed) override;
+
+    // 在哈希表中查找member，返回槽位下标，不存在时返回可以插入的空槽下标
+    size_t findSlot(std::string_view member, uint64_t hash) const;
+    // 清空槽位，并把后面同一探测序列上的元素前移，保证查找不会提前遇到空槽
+    void eraseSlot(size_t index);
+    // 调整哈希表容量
+    void rehash(size_t capacity);
+
+    Slot *m_slotArray = nullptr;
+    // 哈希表容量，2的幂
+    size_t m_capacity = 0;
+};
@@ -0,0 +1,364 @@
+// SortedSet与std::map/std::set模型对照的随机操作测试：
+//   g++ -std=c++17 -O2 SortedSetCheck.cpp SortedSet.cpp SkipList1.cpp SkipListOpLog.cpp -pthread -o sortedset_check
+// 全部检查通过时返回0。
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "SortedSet.h"
+
+// 访问哈希表容量，检查扩容
+class CheckedSortedSet : public SortedSet
+{
+public:
+    size_t capacity() const { return m_capacity; }
+};
+
+// xorshift64，生成测试用的member和score
+static uint64_t nextRandom(uint64_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+// 模型：member到score，以及按{score, member}排序的集合
+struct Model
+{
+    std::map<std::string, long long> m_scoreMap;
+    std::set<std::pair<long long, std::string>> m_orderSet;
+
+    bool add(const std::string &member, long long score)
+    {
+        auto it = m_scoreMap.find(member);
+        if (it != m_scoreMap.end())
+        {
+            m_orderSet.erase({it->second, member});
+            it->second = score;
+            m_orderSet.emplace(score, member);
+            return false;
+        }
+        m_scoreMap.emplace(member, score);
+        m_orderSet.emplace(score, member);
+        return true;
+    }
+
+    bool remove(const std::string &member)
+    {
+        auto it = m_scoreMap.find(member);
+        if (it == m_scoreMap.end())
+        {
+            return false;
+        }
+        m_orderSet.erase({it->second, member});
+        m_scoreMap.erase(it);
+        return true;
+    }
+
+    long rank(const std::string &member) const
+    {
+        auto it = m_scoreMap.find(member);
+        if (it == m_scoreMap.end())
+        {
+            return -1;
+        }
+        return (long)std::distance(m_orderSet.begin(), m_orderSet.find({it->second, member}));
+    }
+
+    // 与SortedSet相同的排名换算，越界时返回false
+    bool normalize(long &start, long &stop) const
+    {
+        long length = (long)m_orderSet.size();
+        if (start < 0)
+        {
+            start += length;
+        }
+        if (stop < 0)
+        {
+            stop += length;
+        }
+        if (start < 0)
+        {
+            start = 0;
+        }
+        if (stop >= length)
+        {
+            stop = length - 1;
+        }
+        return start <= stop;
+    }
+};
+
+// 全部内容逐项对照：size、顺序、score和排名
+static bool compareAll(CheckedSortedSet &sortedSet, const Model &model)
+{
+    if (sortedSet.size() != model.m_orderSet.size())
+    {
+        printf("size mismatch %lu != %zu\n", sortedSet.size(), model.m_orderSet.size());
+        return false;
+    }
+    // 负载因子不超过3/4
+    if (sortedSet.size() * 4 > sortedSet.capacity() * 3)
+    {
+        printf("load factor exceeded: %lu / %zu\n", sortedSet.size(), sortedSet.capacity());
+        return false;
+    }
+
+    std::vector<std::pair<std::string_view, long long>> result;
+    sortedSet.rangeByRank(0, -1, result);
+    long rank = 0;
+    auto it = model.m_orderSet.begin();
+    for (auto &item : result)
+    {
+        long long score = 0;
+        if (it == model.m_orderSet.end() || item.first != it->second || item.second != it->first ||
+            !sortedSet.score(item.first, &score) || score != it->first || sortedSet.rank(item.first) != rank)
+        {
+            printf("content mismatch at rank %ld\n", rank);
+            return false;
+        }
+        ++it;
+        ++rank;
+    }
+
+    return it == model.m_orderSet.end();
+}
+
+// 随机的add/更新/remove/incrBy/rank/rangeByRank/按排名和score删除区间
+static bool verifyRandom(int memberRange, int opCount, uint64_t seed)
+{
+    CheckedSortedSet sortedSet;
+    Model model;
+
+    uint64_t state = seed;
+    for (int i = 0; i < opCount; ++i)
+    {
+        auto random = nextRandom(state);
+        auto member = "m" + std::to_string(random % memberRange);
+        // score范围小，经常出现相同score，按member排序
+        long long score = (long long)(random / 1024 % 64) - 32;
+        bool ok = true;
+        switch (random / 65536 % 16)
+        {
+        case 0:
+        case 1:
+        case 2:
+        case 3:
+        case 4:
+            ok = sortedSet.add(member, score) == model.add(member, score);
+            break;
+        case 5:
+        case 6:
+        {
+            auto it = model.m_scoreMap.find(member);
+            auto expected = (it != model.m_scoreMap.end() ? it->second : 0) + score;
+            model.add(member, expected);
+            ok = sortedSet.incrBy(member, score) == expected;
+            break;
+        }
+        case 7:
+        case 8:
+        case 9:
+            ok = sortedSet.remove(member) == model.remove(member);
+            break;
+        case 10:
+        case 11:
+            ok = sortedSet.rank(member) == model.rank(member);
+            break;
+        case 12:
+        {
+            long start = (long)(random / 1048576 % 40) - 20;
+            long stop = start + (long)(random / 65536 % 8);
+            std::vector<std::pair<std::string_view, long long>> result;
+            sortedSet.rangeByRank(start, stop, result);
+            if (model.normalize(start, stop))
+            {
+                auto it = std::next(model.m_orderSet.begin(), start);
+                ok = result.size() == (size_t)(stop - start + 1);
+                for (size_t j = 0; ok && j < result.size(); ++j, ++it)
+                {
+                    ok = result[j].first == it->second && result[j].second == it->first;
+                }
+            }
+            else
+            {
+                ok = result.empty();
+            }
+            break;
+        }
+        case 13:
+        {
+            // 删除区间小，避免集合很快被清空
+            long start = (long)(random / 1048576 % 40) - 20;
+            long stop = start + (long)(random / 65536 % 3);
+            auto removed = sortedSet.removeRangeByRank(start, stop);
+            unsigned long expected = 0;
+            if (model.normalize(start, stop))
+            {
+                std::vector<std::string> memberArray;
+                for (auto it = std::next(model.m_orderSet.begin(), start); expected < (unsigned long)(stop - start + 1); ++it, ++expected)
+                {
+                    memberArray.push_back(it->second);
+                }
+                for (auto &removedMember : memberArray)
+                {
+                    model.remove(removedMember);
+                }
+            }
+            ok = removed == expected;
+            break;
+        }
+        case 14:
+        {
+            SortedSet::ScoreRange range;
+            range.m_min = score;
+            range.m_max = score + (long long)(random / 1048576 % 3);
+            range.m_minExclusive = random & 1;
+            range.m_maxExclusive = random & 2;
+            std::vector<std::string> memberArray;
+            for (auto &item : model.m_orderSet)
+            {
+                auto aboveMin = range.m_minExclusive ? item.first > range.m_min : item.first >= range.m_min;
+                auto belowMax = range.m_maxExclusive ? item.first < range.m_max : item.first <= range.m_max;
+                if (aboveMin && belowMax)
+                {
+                    memberArray.push_back(item.second);
+                }
+            }
+            for (auto &removedMember : memberArray)
+            {
+                model.remove(removedMember);
+            }
+            ok = sortedSet.removeRangeByScore(range) == memberArray.size();
+            break;
+        }
+        default:
+        {
+            long long actual = 0;
+            auto it = model.m_scoreMap.find(member);
+            ok = sortedSet.score(member, &actual) == (it != model.m_scoreMap.end()) &&
+                 (it == model.m_scoreMap.end() || actual == it->second);
+            break;
+        }
+        }
+
+        if (!ok)
+        {
+            printf("mismatch at op %d, member %s\n", i, member.c_str());
+            return false;
+        }
+        if (i % 997 == 0 && !compareAll(sortedSet, model))
+        {
+            printf("at op %d\n", i);
+            return false;
+        }
+    }
+
+    return compareAll(sortedSet, model);
+}
+
+// 连续添加使哈希表多次超过3/4的负载因子扩容，再删除一半，所有member仍然可以找到
+static bool verifyGrowth(int count)
+{
+    CheckedSortedSet sortedSet;
+    Model model;
+    auto initCapacity = sortedSet.capacity();
+
+    for (int i = 0; i < count; ++i)
+    {
+        auto member = "g" + std::to_string(i);
+        if (sortedSet.add(member, i % 100) != model.add(member, i % 100))
+        {
+            printf("growth add mismatch at %d\n", i);
+            return false;
+        }
+    }
+    if (sortedSet.capacity() <= initCapacity || !compareAll(sortedSet, model))
+    {
+        printf("growth failed, capacity %zu\n", sortedSet.capacity());
+        return false;
+    }
+
+    for (int i = 0; i < count; i += 2)
+    {
+        auto member = "g" + std::to_string(i);
+        sortedSet.remove(member);
+        model.remove(member);
+    }
+    return compareAll(sortedSet, model);
+}
+
+// 用SkipList直接写出member顺序或唯一性不满足要求的快照，data指向std::string
+static std::string_view stringBytes(const void *data)
+{
+    return *static_cast<const std::string *>(data);
+}
+
+static int compareStringDesc(void *a, void *b)
+{
+    return -static_cast<std::string *>(a)->compare(*static_cast<std::string *>(b));
+}
+
+// 快照：正常保存后恢复内容一致；score相同但member逆序、member重复的快照被拒绝，集合保持为空
+static bool verifySnapshot(const char *path)
+{
+    CheckedSortedSet sortedSet;
+    Model model;
+    for (int i = 0; i < 5000; ++i)
+    {
+        auto member = "s" + std::to_string(i);
+        sortedSet.add(member, i % 37);
+        model.add(member, i % 37);
+    }
+    CheckedSortedSet loaded;
+    if (!sortedSet.saveSnapshot(path) || !loaded.loadSnapshot(path) || !compareAll(loaded, model))
+    {
+        printf("snapshot round trip failed\n");
+        return false;
+    }
+
+    std::string a = "a", b = "b", c = "c", a2 = "a";
+    // 同一score按member降序：b, a
+    SkipList unordered{compareStringDesc};
+    unordered.insert(1, &a);
+    unordered.insert(1, &b);
+    // score递增但member重复：a, c, a
+    SkipList duplicate;
+    duplicate.insert(1, &a);
+    duplicate.insert(2, &c);
+    duplicate.insert(3, &a2);
+
+    for (auto bad : {&unordered, &duplicate})
+    {
+        CheckedSortedSet rejected;
+        if (!bad->saveSnapshot(path, stringBytes) || rejected.loadSnapshot(path) || rejected.size() != 0 ||
+            rejected.score("a", nullptr) || !rejected.add("a", 1) || rejected.size() != 1)
+        {
+            printf("bad snapshot accepted\n");
+            return false;
+        }
+    }
+
+    remove(path);
+    return true;
+}
+
+int main()
+{
+    printf("begin\n");
+
+    bool ok = true;
+    ok = verifyRandom(50, 200000, 0x9e3779b97f4a7c15ull) && ok;
+    ok = verifyRandom(2000, 200000, 0x2545f4914f6cdd1dull) && ok;
+    ok = verifyGrowth(100000) && ok;
+    ok = verifySnapshot("sortedset_check.snap") && ok;
+
+    printf("%s\n", ok ? "ok" : "FAILED");
+    printf("end\n");
+
+    return ok ? 0 : 1;
+}